@@ -0,0 +1,37 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+#include "hardware/regs/addressmap.h"
+#include "calib_store.h"
+
+// 标定数据放在flash最后一个扇区, 程序映像远小于flash, 不会用到这里
+#define CALIB_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#define CALIB_FLASH_BYTES ((CALIB_STORE_MAX + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE)
+#define CALIB_FLASH_TIMEOUT_MS 100 // 等另一个核停下的时间
+
+_Static_assert(CALIB_FLASH_BYTES <= FLASH_SECTOR_SIZE, "calibration record exceeds one flash sector");
+
+// 经XIP直接读, 长度按一个扇区给calib_store_load
+const uint8_t *calib_flash_data()
+{
+    return (const uint8_t *)(XIP_BASE + CALIB_FLASH_OFFSET);
+}
+
+// 擦写期间不能从flash取指: 由flash_safe_execute关中断并让另一个核停在RAM里
+static void calib_flash_program(void *param)
+{
+    flash_range_erase(CALIB_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(CALIB_FLASH_OFFSET, (const uint8_t *)param, CALIB_FLASH_BYTES);
+}
+
+// 另一个核须已调用flash_safe_execute_core_init()
+bool calib_flash_write(const uint8_t *blob, size_t len)
+{
+    static uint8_t page[CALIB_FLASH_BYTES];
+    if (len > sizeof(page))
+        return false;
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, blob, len);
+    return flash_safe_execute(calib_flash_program, page, CALIB_FLASH_TIMEOUT_MS) == PICO_OK;
+}
@@ -0,0 +1,99 @@
+#include <string.h>
+#include "calib_store.h"
+#include "frame_proto.h"
+
+int calib_store_capture(calib_store_t *store, sensor_array_t *a, uint8_t spad_map_id)
+{
+    store->count = 0;
+    for (uint8_t i = 0; i < a->count; i++)
+    {
+        if (a->state[i] != SENSOR_READY)
+            continue;
+        calib_entry_t *e = &store->entries[store->count];
+        tmf8821_select(&a->devs[i]);
+        if (tmf8821_factory_calibrate(e->data) != TMF8821_OK)
+            continue;
+        e->addr = a->devs[i].addr;
+        e->spad_map_id = spad_map_id;
+        store->count++;
+    }
+    return store->count;
+}
+
+int calib_store_merge(calib_store_t *store, const calib_store_t *from)
+{
+    int merged = 0;
+    for (uint8_t k = 0; k < from->count; k++)
+    {
+        const calib_entry_t *e = &from->entries[k];
+        uint8_t i = 0;
+        while (i < store->count && store->entries[i].addr != e->addr)
+            i++;
+        if (i == SENSOR_MAX)
+            continue;
+        if (i == store->count)
+            store->count++;
+        store->entries[i] = *e;
+        merged++;
+    }
+    return merged;
+}
+
+int calib_store_restore(const calib_store_t *store, sensor_array_t *a, uint8_t spad_map_id)
+{
+    int restored = 0;
+    for (uint8_t i = 0; i < a->count; i++)
+    {
+        if (a->state[i] != SENSOR_READY)
+            continue;
+        for (uint8_t k = 0; k < store->count; k++)
+        {
+            const calib_entry_t *e = &store->entries[k];
+            if (e->addr != a->devs[i].addr || e->spad_map_id != spad_map_id)
+                continue;
+            tmf8821_select(&a->devs[i]);
+            restored += tmf8821_write_calibration(e->data) == TMF8821_OK;
+            break;
+        }
+    }
+    return restored;
+}
+
+// 返回写入的字节数, blob至少CALIB_STORE_MAX字节
+size_t calib_store_save(const calib_store_t *store, uint8_t *blob)
+{
+    size_t len = CALIB_STORE_SIZE(store->count);
+    blob[0] = CALIB_STORE_VERSION;
+    blob[1] = store->count;
+    uint8_t *p = &blob[CALIB_STORE_HEADER];
+    for (uint8_t k = 0; k < store->count; k++, p += CALIB_STORE_ENTRY)
+    {
+        p[0] = store->entries[k].addr;
+        p[1] = store->entries[k].spad_map_id;
+        memcpy(&p[2], store->entries[k].data, CALIB_DATA_SIZE);
+    }
+    uint16_t crc = proto_crc16(blob, len - 2);
+    blob[len - 2] = crc & 0xFF;
+    blob[len - 1] = crc >> 8;
+    return len;
+}
+
+bool calib_store_load(calib_store_t *store, const uint8_t *blob, size_t len)
+{
+    if (len < CALIB_STORE_SIZE(0) || blob[0] != CALIB_STORE_VERSION || blob[1] > SENSOR_MAX ||
+        len < (size_t)CALIB_STORE_SIZE(blob[1]))
+        return false;
+    size_t n = CALIB_STORE_SIZE(blob[1]);
+    if (proto_crc16(blob, n - 2) != (blob[n - 2] | (blob[n - 1] << 8)))
+        return false;
+
+    const uint8_t *p = &blob[CALIB_STORE_HEADER];
+    store->count = blob[1];
+    for (uint8_t k = 0; k < store->count; k++, p += CALIB_STORE_ENTRY)
+    {
+        store->entries[k].addr = p[0];
+        store->entries[k].spad_map_id = p[1];
+        memcpy(store->entries[k].data, &p[2], CALIB_DATA_SIZE);
+    }
+    return true;
+}
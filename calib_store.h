@@ -0,0 +1,48 @@
+#ifndef CALIB_STORE_H
+#define CALIB_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sensor_array.h"
+
+// 工厂标定的保存与恢复: 每个传感器一份标定数据, 连同工作地址和标定时的SPAD图.
+// 启动时按地址和SPAD图对上号才写回, 存的数据缺失或损坏时照常以未标定状态运行
+#define CALIB_STORE_VERSION 1
+
+// 二进制格式(小端), 末尾CRC16与frame_proto相同; 擦除后的flash(全0xFF)版本号不对, 视为没有:
+//   version(1) count(1) 然后count个 addr(1) spad_map_id(1) data(CALIB_DATA_SIZE)
+#define CALIB_STORE_HEADER 2
+#define CALIB_STORE_ENTRY (2 + CALIB_DATA_SIZE)
+#define CALIB_STORE_SIZE(count) (CALIB_STORE_HEADER + (count) * CALIB_STORE_ENTRY + 2)
+#define CALIB_STORE_MAX CALIB_STORE_SIZE(SENSOR_MAX)
+
+typedef struct
+{
+    uint8_t addr;
+    uint8_t spad_map_id;
+    uint8_t data[CALIB_DATA_SIZE];
+} calib_entry_t;
+
+typedef struct
+{
+    uint8_t count;
+    calib_entry_t entries[SENSOR_MAX];
+} calib_store_t;
+
+// 在每个就绪的传感器上做工厂标定, 须已写好测量配置; 返回标定成功的个数
+int calib_store_capture(calib_store_t *store, sensor_array_t *a, uint8_t spad_map_id);
+// 把from里的各项按地址并进store: 同地址的替换, 新地址的追加; 返回并入的项数
+int calib_store_merge(calib_store_t *store, const calib_store_t *from);
+// 写回地址和SPAD图都对得上的传感器, 返回写回的个数
+int calib_store_restore(const calib_store_t *store, sensor_array_t *a, uint8_t spad_map_id);
+
+// 序列化, 载入失败(版本、长度或CRC不对)时不改动store; len为可读的字节数
+size_t calib_store_save(const calib_store_t *store, uint8_t *blob);
+bool calib_store_load(calib_store_t *store, const uint8_t *blob, size_t len);
+
+// Pico后端(calib_flash.c): flash最后一个扇区
+const uint8_t *calib_flash_data();
+bool calib_flash_write(const uint8_t *blob, size_t len);
+
+#endif
@@ -0,0 +1,134 @@
+#include <string.h>
+#include "classifier.h"
+#include "frame_proto.h"
+
+// 默认表: 只看第0区, 区间与原来的逐值比较相同
+// 0x52/0x53 运动饮料, 0x55 水, 0x57/0x58 可乐
+const classifier_table_t classifier_default_table = {
+    .min_confidence = 1,
+    .count = 3,
+    .zone_mask = 0x0001,
+    .classes = {
+        {PROTO_LABEL_SPORTS_DRINK, 0x52 * 16 - 8, 0x53 * 16 + 8},
+        {PROTO_LABEL_WATER, 0x55 * 16 - 8, 0x55 * 16 + 8},
+        {PROTO_LABEL_COLA, 0x57 * 16 - 8, 0x58 * 16 + 8},
+    },
+};
+
+void classifier_init(classifier_t *c, const classifier_table_t *table)
+{
+    c->table = *table;
+    c->zones = 0;
+    for (int z = 0; z < RESULT_ZONES; z++)
+        c->zones += (table->zone_mask >> z) & 1;
+    classifier_reset(c);
+}
+
+// 清空窗口, 例如换杯或切换测量配置后
+void classifier_reset(classifier_t *c)
+{
+    memset(c->w, 0, sizeof(c->w));
+    memset(c->wd, 0, sizeof(c->wd));
+    c->sum_w = 0;
+    c->sum_wd = 0;
+    c->head = 0;
+    c->frames = 0;
+}
+
+void classifier_update(classifier_t *c, const tmf8821_object_t *objects, classifier_result_t *out)
+{
+    const classifier_table_t *t = &c->table;
+    uint32_t w = 0, wd = 0;
+
+    // 不参与的区权重为0, 不走分支
+    for (int z = 0; z < RESULT_ZONES; z++)
+    {
+        uint32_t conf = objects[z].confidence;
+        uint32_t use = ((t->zone_mask >> z) & 1) & (conf >= t->min_confidence);
+        int32_t d = (int32_t)(objects[z].distance_mm << 4) - t->zone_offset_q4[z];
+        d &= ~(d >> 31);         // 负数截为0
+        d = d > 0xFFFF ? 0xFFFF : d; // 超出4 m的距离与分类无关
+        conf &= -use;
+        w += conf;
+        wd += conf * (uint32_t)d;
+    }
+
+    // 滑动窗口: 减去最旧一帧, 加上新一帧
+    c->sum_w += w - c->w[c->head];
+    c->sum_wd += wd - c->wd[c->head];
+    c->w[c->head] = w;
+    c->wd[c->head] = wd;
+    c->head = (c->head + 1) & (CLASSIFIER_WINDOW - 1);
+    if (c->frames < CLASSIFIER_WINDOW)
+        c->frames++;
+
+    uint32_t dist = c->sum_w ? (c->sum_wd + c->sum_w / 2) / c->sum_w : 0;
+    uint8_t label = PROTO_LABEL_UNKNOWN;
+    for (int i = 0; i < CLASSIFIER_MAX_CLASSES; i++)
+    {
+        const classifier_class_t *k = &t->classes[i];
+        bool hit = (i < t->count) & (dist >= k->min_q4) & (dist < k->max_q4);
+        label = hit ? k->label : label;
+    }
+
+    out->label = c->sum_w ? label : PROTO_LABEL_UNKNOWN;
+    out->confidence = c->zones ? c->sum_w / (c->frames * c->zones) : 0;
+    out->distance_q4 = dist;
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+bool classifier_load(classifier_table_t *table, const uint8_t *blob, size_t len)
+{
+    if (len < CLASSIFIER_BLOB_SIZE(0) || blob[0] != CLASSIFIER_TABLE_VERSION || blob[1] > CLASSIFIER_MAX_CLASSES ||
+        len != (size_t)CLASSIFIER_BLOB_SIZE(blob[1]) || proto_crc16(blob, len - 2) != get16(&blob[len - 2]))
+        return false;
+
+    classifier_table_t t;
+    memset(&t, 0, sizeof(t));
+    t.count = blob[1];
+    t.min_confidence = blob[2];
+    t.zone_mask = get16(&blob[4]);
+    for (int z = 0; z < RESULT_ZONES; z++)
+        t.zone_offset_q4[z] = (int16_t)get16(&blob[6 + z * 2]);
+    const uint8_t *p = &blob[CLASSIFIER_BLOB_HEADER];
+    for (int i = 0; i < t.count; i++, p += 5)
+    {
+        t.classes[i].label = p[0];
+        t.classes[i].min_q4 = get16(&p[1]);
+        t.classes[i].max_q4 = get16(&p[3]);
+    }
+    *table = t;
+    return true;
+}
+
+// 返回写入的字节数, blob至少CLASSIFIER_BLOB_MAX字节
+size_t classifier_save(const classifier_table_t *table, uint8_t *blob)
+{
+    size_t len = CLASSIFIER_BLOB_SIZE(table->count);
+    blob[0] = CLASSIFIER_TABLE_VERSION;
+    blob[1] = table->count;
+    blob[2] = table->min_confidence;
+    blob[3] = 0;
+    put16(&blob[4], table->zone_mask);
+    for (int z = 0; z < RESULT_ZONES; z++)
+        put16(&blob[6 + z * 2], (uint16_t)table->zone_offset_q4[z]);
+    uint8_t *p = &blob[CLASSIFIER_BLOB_HEADER];
+    for (int i = 0; i < table->count; i++, p += 5)
+    {
+        p[0] = table->classes[i].label;
+        put16(&p[1], table->classes[i].min_q4);
+        put16(&p[3], table->classes[i].max_q4);
+    }
+    put16(&blob[len - 2], proto_crc16(blob, len - 2));
+    return len;
+}
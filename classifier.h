@@ -0,0 +1,69 @@
+#ifndef CLASSIFIER_H
+#define CLASSIFIER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "tmf8821.h"
+
+// 表驱动液体分类: 多区按置信度加权平均距离, 再在短窗口内平均, 查标定表得到类别
+// 距离用1/16 mm定点数(Q4), 每帧固定遍历全部区和全部表项, 耗时与数据无关
+#define CLASSIFIER_WINDOW 8 // 帧, 必须是2的幂
+#define CLASSIFIER_MAX_CLASSES 8
+#define CLASSIFIER_TABLE_VERSION 1
+
+// 标定表二进制格式(小端), 末尾CRC16与frame_proto相同:
+//   version(1) count(1) min_confidence(1) 保留(1) zone_mask(2) zone_offset_q4(2×9)
+//   然后count个 label(1) min_q4(2) max_q4(2)
+#define CLASSIFIER_BLOB_HEADER (6 + RESULT_ZONES * 2)
+#define CLASSIFIER_BLOB_SIZE(count) (CLASSIFIER_BLOB_HEADER + (count) * 5 + 2)
+#define CLASSIFIER_BLOB_MAX CLASSIFIER_BLOB_SIZE(CLASSIFIER_MAX_CLASSES)
+
+typedef struct
+{
+    uint8_t label;   // PROTO_LABEL_*
+    uint16_t min_q4; // 距离下限(含)
+    uint16_t max_q4; // 距离上限(不含)
+} classifier_class_t;
+
+typedef struct
+{
+    uint8_t min_confidence;               // 低于此置信度的区不参与
+    uint8_t count;
+    uint16_t zone_mask;                   // 参与分类的区
+    int16_t zone_offset_q4[RESULT_ZONES]; // 各区相对安装位置的距离偏差, 先减去再平均
+    classifier_class_t classes[CLASSIFIER_MAX_CLASSES];
+} classifier_table_t;
+
+typedef struct
+{
+    uint8_t label;
+    uint8_t confidence;   // 窗口内参与区的平均置信度
+    uint16_t distance_q4; // 窗口内加权平均距离
+} classifier_result_t;
+
+typedef struct
+{
+    classifier_table_t table;
+    uint8_t zones;                 // zone_mask中的区数
+    uint8_t head;
+    uint8_t frames;                // 窗口内已有帧数
+    uint32_t w[CLASSIFIER_WINDOW];  // 每帧置信度之和
+    uint32_t wd[CLASSIFIER_WINDOW]; // 每帧置信度×距离之和
+    uint32_t sum_w;
+    uint32_t sum_wd;
+} classifier_t;
+
+extern const classifier_table_t classifier_default_table;
+
+void classifier_init(classifier_t *c, const classifier_table_t *table);
+void classifier_reset(classifier_t *c);
+
+// objects为一帧的目标, 只用前RESULT_ZONES个(各区第一目标)
+void classifier_update(classifier_t *c, const tmf8821_object_t *objects, classifier_result_t *out);
+
+// 标定表序列化, 载入失败(长度、版本或CRC不对)时不改动table
+bool classifier_load(classifier_table_t *table, const uint8_t *blob, size_t len);
+size_t classifier_save(const classifier_table_t *table, uint8_t *blob);
+
+#endif
@@ -0,0 +1,55 @@
+#include <string.h>
+#include "depth_frame.h"
+
+void depth_assembler_init(depth_assembler_t *a, const tmf8821_spad_map_t *map)
+{
+    memset(a, 0, sizeof(*a));
+    a->map = map;
+    a->frame.spad_map_id = map->id;
+    a->frame.rows = map->rows;
+    a->frame.cols = map->cols;
+}
+
+bool depth_assembler_add(depth_assembler_t *a, const tmf8821_frame_t *f, uint32_t timestamp_us)
+{
+    const tmf8821_spad_map_t *map = a->map;
+    if (!a->started)
+    {
+        a->origin = f->number;
+        a->started = true;
+    }
+    uint8_t sub = (uint8_t)(f->number - a->origin) % map->sub_frames;
+    uint8_t base = f->number - sub;
+    uint8_t all = (1u << map->sub_frames) - 1;
+
+    a->sub_frames++;
+    if (a->have && (base != a->base || (a->have & (1u << sub))))
+    { // 编号跳过了这一幅剩下的子帧
+        a->incomplete++;
+        a->have = 0;
+    }
+    if (!a->have)
+    {
+        a->base = base;
+        memset(a->frame.zones, 0, sizeof(a->frame.zones));
+    }
+
+    const uint8_t *zone_of = map->zone_of[sub];
+    for (int c = 0; c < RESULT_ZONES; c++)
+    {
+        uint8_t z = zone_of[c];
+        if (z == SPAD_ZONE_NONE)
+            continue;
+        for (int o = 0; o < RESULT_OBJECTS; o++)
+            a->frame.zones[o][z] = f->objects[o][c];
+    }
+    a->have |= 1u << sub;
+    if (a->have != all)
+        return false;
+
+    a->have = 0;
+    a->frames++;
+    a->frame.number = base;
+    a->frame.timestamp_us = timestamp_us;
+    return true;
+}
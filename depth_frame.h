@@ -0,0 +1,36 @@
+#ifndef DEPTH_FRAME_H
+#define DEPTH_FRAME_H
+
+#include "tmf8821.h"
+
+// 把分时复用模式的子帧拼成一幅深度图: 按结果编号与开始测量后第一帧的差定子采集序号
+// 和所属的幅, 编号跳到下一幅时没拼齐的那幅作废. 单次采集的模式每个结果页直接就是一幅.
+// 每次开始测量前都要重新init
+typedef struct
+{
+    uint32_t timestamp_us; // 最后一个子帧的时间
+    uint8_t number;        // 第一个子帧的结果编号
+    uint8_t spad_map_id;
+    uint8_t rows;
+    uint8_t cols;
+    tmf8821_object_t zones[RESULT_OBJECTS][TMF8821_ZONES_MAX]; // 行优先
+} depth_frame_t;
+
+typedef struct
+{
+    const tmf8821_spad_map_t *map;
+    depth_frame_t frame;     // 正在拼的一幅, depth_assembler_add返回true时为拼好的
+    uint8_t have;            // 已收到的子采集位图
+    uint8_t base;            // 正在拼的一幅的第一个结果编号
+    uint8_t origin;          // 开始测量后第一帧的结果编号
+    bool started;
+    uint32_t frames;         // 拼好的幅数
+    uint32_t incomplete;     // 缺子帧作废的幅数
+    uint32_t sub_frames;     // 收到的结果页
+} depth_assembler_t;
+
+void depth_assembler_init(depth_assembler_t *a, const tmf8821_spad_map_t *map);
+// 加一个结果页, 拼齐一幅时返回true, 结果在a->frame里, 下次调用前有效
+bool depth_assembler_add(depth_assembler_t *a, const tmf8821_frame_t *f, uint32_t timestamp_us);
+
+#endif
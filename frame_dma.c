@@ -0,0 +1,268 @@
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "frame_dma.h"
+#include "trace.h"
+
+#define DMA_TX_LEVEL 8 // TX FIFO(16级)降到一半就补命令, 线上不断流
+
+// 所有总线共用的命令序列, DMA只读
+static uint32_t cmds[FRAME_DMA_CMDS];
+static frame_dma_t *engine; // 中断处理函数没有参数
+
+static i2c_inst_t *dma_port(uint8_t b)
+{
+    return b ? i2c1 : i2c0;
+}
+
+// 每个字写进IC_DATA_CMD: 低8位为数据, CMD位为读, STOP/RESTART控制时序;
+// STOP之后控制器见到下一个字会自己发起始位
+static void dma_build_cmds(void)
+{
+    cmds[0] = INT_CLEAR_REG;
+    cmds[1] = INT_RESULT | I2C_IC_DATA_CMD_STOP_BITS;
+    cmds[2] = CONFIG_RESULT_REG;
+    for (uint32_t i = 0; i < RESULT_FRAME_SIZE; i++)
+        cmds[3 + i] = I2C_IC_DATA_CMD_CMD_BITS;
+    cmds[3] |= I2C_IC_DATA_CMD_RESTART_BITS;
+    cmds[FRAME_DMA_CMDS - 1] |= I2C_IC_DATA_CMD_STOP_BITS;
+}
+
+// 在总线上(重新)开始当前传感器的序列: 换目标地址, 先开读通道再开写通道
+static void dma_submit(frame_dma_t *dma, uint8_t b)
+{
+    frame_dma_bus_t *bus = &dma->buses[b];
+    i2c_hw_t *hw = i2c_get_hw(dma_port(b));
+    uint32_t now = time_us_32();
+    uint32_t waited = now - dma->edge_us[bus->sensor];
+    TRACE(TRACE_DMA_START, bus->sensor, waited > 0xFFFF ? 0xFFFF : waited);
+    bus->start_us = now;
+
+    hw->enable = 0; // 目标地址只能在控制器关闭时改
+    hw->tar = dma->array->devs[bus->sensor].addr;
+    hw->dma_tdlr = DMA_TX_LEVEL; // 总线恢复会复位控制器, 每次都设
+    hw->enable = 1;
+    (void)hw->clr_tx_abrt;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+    dma_channel_transfer_to_buffer_now(bus->rx_chan, bus->slot->data, RESULT_FRAME_SIZE);
+    dma_channel_transfer_from_buffer_now(bus->tx_chan, cmds, FRAME_DMA_CMDS);
+}
+
+// 总线空闲时开始下一个排队的传感器, 序号小的先; 队列满时读进scratch, 只为清掉INT
+static void dma_start_next(frame_dma_t *dma, uint8_t b)
+{
+    frame_dma_bus_t *bus = &dma->buses[b];
+    for (uint8_t i = 0; i < dma->array->count; i++)
+    {
+        if (!(dma->pending & (1u << i)) || dma->bus_of[i] != b)
+            continue;
+        dma->pending &= ~(1u << i);
+        bus->sensor = i;
+        bus->attempts = 0;
+        bus->slot = frame_queue_reserve(dma->queue);
+        if (bus->slot == NULL)
+        {
+            TRACE(TRACE_FRAME_DROP, i, 0);
+            bus->slot = &bus->scratch;
+        }
+        dma_submit(dma, b);
+        return;
+    }
+}
+
+// 序列结束: 记总线统计, 发布或作废槽, 接着做这条总线上排队的下一个
+static void dma_finish(frame_dma_t *dma, uint8_t b, bool ok)
+{
+    frame_dma_bus_t *bus = &dma->buses[b];
+    uint8_t sensor = bus->sensor;
+    result_frame_t *slot = bus->slot;
+
+    bool valid = ok && slot->frame.page_id == RESULT_PAGE_ID;
+    if (slot != &bus->scratch)
+    {
+        slot->timestamp_us = dma->edge_us[sensor];
+        slot->run = dma->array->run;
+        slot->spad_map_id = dma->array->spad_map_id;
+        if (valid)
+            slot->sensor = sensor;
+        frame_queue_complete(dma->queue, slot, valid);
+        if (valid)
+        {
+            dma->frames++;
+            tmf8821_power_frame(&dma->array->devs[sensor], slot->timestamp_us);
+            TRACE(TRACE_FRAME_READY, sensor, slot->frame.number);
+        }
+    }
+    bus->sensor = -1;
+    dma_start_next(dma, b);
+}
+
+// 中止当前序列: NACK直接重试, 超时先恢复总线(i2c_error)再重试; 重试就在中断里马上做
+static void dma_abort(frame_dma_t *dma, uint8_t b, int error)
+{
+    frame_dma_bus_t *bus = &dma->buses[b];
+    i2c_hw_t *hw = i2c_get_hw(dma_port(b));
+
+    // RP2040-E13: 中止前先关通道中断, 否则中止本身会报完成
+    dma_channel_set_irq1_enabled(bus->rx_chan, false);
+    dma_channel_abort(bus->rx_chan);
+    dma_channel_abort(bus->tx_chan);
+    dma_channel_acknowledge_irq1(bus->rx_chan);
+    dma_channel_set_irq1_enabled(bus->rx_chan, true);
+    hw->intr_mask = 0;
+    (void)hw->clr_tx_abrt;
+
+    dma->aborts++;
+    TRACE(TRACE_DMA_DONE, bus->sensor, 0xFFFF);
+    i2c_error(&i2c_pico_transports[b], error); // 不改当前选择, 被打断的驱动调用不受影响
+    if (++bus->attempts <= I2C_RETRIES)
+    {
+        dma_submit(dma, b);
+        return;
+    }
+    dma->failures++;
+    dma_finish(dma, b, false);
+}
+
+// 读通道完成 = 最后一个字节(含STOP)已收到
+static void dma_irq(void)
+{
+    uint32_t start = time_us_32();
+    for (uint8_t b = 0; b < I2C_PICO_BUSES; b++)
+    {
+        frame_dma_bus_t *bus = &engine->buses[b];
+        if (bus->sensor < 0 || !dma_channel_get_irq1_status(bus->rx_chan))
+            continue;
+        dma_channel_acknowledge_irq1(bus->rx_chan);
+        i2c_get_hw(dma_port(b))->intr_mask = 0;
+        uint32_t took = start - bus->start_us;
+        TRACE(TRACE_DMA_DONE, bus->sensor, took > 0xFFFF ? 0xFFFF : took);
+        i2c_account(engine->array->devs[bus->sensor].bus_hz, 3, FRAME_DMA_CMDS, bus->start_us);
+        dma_finish(engine, b, true);
+    }
+    engine->irq_us += time_us_32() - start;
+}
+
+// 地址或数据没有应答: 控制器冲掉TX FIFO, 读通道永远等不齐
+static void dma_i2c_irq(uint8_t b)
+{
+    uint32_t start = time_us_32();
+    i2c_hw_t *hw = i2c_get_hw(dma_port(b));
+    if (engine->buses[b].sensor >= 0 && (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS))
+        dma_abort(engine, b, I2C_ERR_NACK);
+    else
+        hw->intr_mask = 0;
+    engine->irq_us += time_us_32() - start;
+}
+
+static void dma_i2c0_irq(void)
+{
+    dma_i2c_irq(0);
+}
+
+static void dma_i2c1_irq(void)
+{
+    dma_i2c_irq(1);
+}
+
+// 每条用到的总线申请一对DMA通道: 写通道32位送命令字, 读通道8位收数据
+bool frame_dma_init(frame_dma_t *dma, sensor_array_t *array, frame_queue_t *queue)
+{
+    *dma = (frame_dma_t){.array = array, .queue = queue};
+    uint32_t bus_hz[I2C_PICO_BUSES] = {0};
+    for (uint8_t b = 0; b < I2C_PICO_BUSES; b++)
+        dma->buses[b].sensor = -1;
+    for (uint8_t i = 0; i < array->count; i++)
+    {
+        uint8_t b = 0;
+        while (b < I2C_PICO_BUSES && array->devs[i].bus != &i2c_pico_transports[b])
+            b++;
+        if (b == I2C_PICO_BUSES)
+            return false;
+        dma->bus_of[i] = b;
+        bus_hz[b] = array->devs[i].bus_hz;
+    }
+
+    dma_build_cmds();
+    engine = dma;
+    for (uint8_t b = 0; b < I2C_PICO_BUSES; b++)
+    {
+        if (!bus_hz[b])
+            continue;
+        frame_dma_bus_t *bus = &dma->buses[b];
+        i2c_inst_t *port = dma_port(b);
+        i2c_hw_t *hw = i2c_get_hw(port);
+        bus->timeout_us = I2C_TIMEOUT_BASE_US + 2 * (FRAME_DMA_CMDS + 3) * 9 * 1000000ull / bus_hz[b];
+        bus->tx_chan = dma_claim_unused_channel(true);
+        bus->rx_chan = dma_claim_unused_channel(true);
+
+        dma_channel_config c = dma_channel_get_default_config(bus->tx_chan);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+        channel_config_set_read_increment(&c, true);
+        channel_config_set_write_increment(&c, false);
+        channel_config_set_dreq(&c, i2c_get_dreq(port, true));
+        dma_channel_configure(bus->tx_chan, &c, &hw->data_cmd, cmds, FRAME_DMA_CMDS, false);
+
+        c = dma_channel_get_default_config(bus->rx_chan);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+        channel_config_set_read_increment(&c, false);
+        channel_config_set_write_increment(&c, true);
+        channel_config_set_dreq(&c, i2c_get_dreq(port, false));
+        dma_channel_configure(bus->rx_chan, &c, NULL, &hw->data_cmd, RESULT_FRAME_SIZE, false);
+        dma_channel_set_irq1_enabled(bus->rx_chan, true);
+
+        irq_set_exclusive_handler(I2C0_IRQ + b, b ? dma_i2c1_irq : dma_i2c0_irq);
+        irq_set_enabled(I2C0_IRQ + b, true);
+    }
+    irq_set_exclusive_handler(DMA_IRQ_1, dma_irq);
+    irq_set_enabled(DMA_IRQ_1, true);
+    dma->ready = true;
+    return true;
+}
+
+void frame_dma_enable(frame_dma_t *dma, bool on)
+{
+    while (!on)
+    {
+        frame_dma_poll(dma);
+        bool busy = dma->pending != 0;
+        for (uint8_t b = 0; b < I2C_PICO_BUSES; b++)
+            busy |= dma->buses[b].sensor >= 0;
+        if (!busy)
+            break;
+        tight_loop_contents();
+    }
+    dma->enabled = on && dma->ready;
+}
+
+bool frame_dma_trigger(frame_dma_t *dma, uint8_t sensor, uint32_t edge_us)
+{
+    if (!dma->enabled)
+        return false;
+    uint8_t b = dma->bus_of[sensor];
+    dma->edge_us[sensor] = edge_us;
+    dma->pending |= 1u << sensor;
+    if (dma->buses[b].sensor < 0)
+        dma_start_next(dma, b);
+    return true;
+}
+
+// 传输超过按线上时间算的时限: 多半是从机把SDA拉死, DW控制器自己不会超时
+void frame_dma_poll(frame_dma_t *dma)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    for (uint8_t b = 0; b < I2C_PICO_BUSES; b++)
+    {
+        frame_dma_bus_t *bus = &dma->buses[b];
+        if (bus->sensor >= 0 && time_us_32() - bus->start_us > bus->timeout_us)
+            dma_abort(dma, b, I2C_ERR_TIMEOUT);
+    }
+    restore_interrupts(irq);
+}
+
+bool frame_dma_busy(frame_dma_t *dma, uint8_t sensor)
+{
+    return (dma->pending & (1u << sensor)) || dma->buses[dma->bus_of[sensor]].sensor == sensor;
+}
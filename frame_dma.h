@@ -0,0 +1,53 @@
+#ifndef FRAME_DMA_H
+#define FRAME_DMA_H
+
+#include "frame_queue.h"
+#include "sensor_array.h"
+
+// DMA取结果帧: INT下降沿时在I²C控制器上启动一段预先编好的命令序列
+// (写INT_CLEAR清结果中断 -> STOP -> 写结果页地址 -> 重复起始读整页 -> STOP),
+// 命令字由一个DMA通道送进IC_DATA_CMD, 读回的字节由另一个通道直接写进帧队列的槽,
+// 读完在DMA中断里发布. CPU只在开始和结束各碰一次, 不做逐字节的工作;
+// 两条总线各有一对通道, 传输互相重叠. 直方图模式要先读状态再分包处理, 仍走CPU读
+#define FRAME_DMA_CMDS (3 + RESULT_FRAME_SIZE) // 清中断2个字 + 页地址1个字 + 每个读字节1个字
+
+typedef struct
+{
+    volatile int8_t sensor; // 正在传输的传感器, -1为空闲
+    uint8_t attempts;
+    uint8_t tx_chan;
+    uint8_t rx_chan;
+    uint32_t timeout_us;    // 按线上时间算, 超过即认为总线卡死
+    uint32_t start_us;
+    result_frame_t *slot;   // 队列满时指向scratch, 照样读完以清掉INT
+    result_frame_t scratch;
+} frame_dma_bus_t;
+
+typedef struct
+{
+    sensor_array_t *array;
+    frame_queue_t *queue;
+    bool ready;                       // 初始化成功
+    bool enabled;
+    uint8_t bus_of[SENSOR_MAX];       // 传感器所在的总线(i2c_pico_transports的序号)
+    uint32_t edge_us[SENSOR_MAX];     // INT下降沿(进GPIO中断)的时间, 即帧时间戳
+    volatile uint32_t pending;        // INT已拉低、还没开始取的传感器位图
+    frame_dma_bus_t buses[I2C_PICO_BUSES];
+    uint32_t frames;
+    uint32_t aborts;                  // NACK中止和超时
+    uint32_t failures;                // 重试用完仍失败
+    uint32_t irq_us;                  // DMA/I2C中断里花的CPU时间
+} frame_dma_t;
+
+// 在core1上初始化(中断只在初始化所在的核上响应); 传感器须用Pico总线
+bool frame_dma_init(frame_dma_t *dma, sensor_array_t *array, frame_queue_t *queue);
+// 关闭前等正在进行和排队的传输做完, 之后才能用CPU读写同一总线
+void frame_dma_enable(frame_dma_t *dma, bool on);
+// GPIO中断里调用: 启用时排队取帧并返回true, 否则返回false由调用方用CPU读
+bool frame_dma_trigger(frame_dma_t *dma, uint8_t sensor, uint32_t edge_us);
+// 周期调用: 检查卡死的传输, 中止后恢复总线并重试
+void frame_dma_poll(frame_dma_t *dma);
+// 这个传感器的帧在排队或正在传输
+bool frame_dma_busy(frame_dma_t *dma, uint8_t sensor);
+
+#endif
@@ -0,0 +1,372 @@
+#include <string.h>
+#include "frame_proto.h"
+
+// CRC-16/CCITT-FALSE (多项式0x1021, 初值0xFFFF), 半字节查表
+uint16_t proto_crc16(const uint8_t *data, size_t len)
+{
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    };
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+// COBS编码, 输出不含0x00, 返回编码长度(不含分隔符)
+size_t proto_cobs_encode(const uint8_t *src, size_t len, uint8_t *dst)
+{
+    size_t code_at = 0;
+    size_t out = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (src[i] == 0)
+        {
+            dst[code_at] = code;
+            code_at = out++;
+            code = 1;
+            continue;
+        }
+        dst[out++] = src[i];
+        if (++code == 0xFF)
+        {
+            dst[code_at] = code;
+            code_at = out++;
+            code = 1;
+        }
+    }
+    dst[code_at] = code;
+    return out;
+}
+
+// COBS解码(输入不含分隔符), 格式错误返回0
+size_t proto_cobs_decode(const uint8_t *src, size_t len, uint8_t *dst)
+{
+    size_t in = 0;
+    size_t out = 0;
+    while (in < len)
+    {
+        uint8_t code = src[in++];
+        if (code == 0 || in + code - 1 > len)
+            return 0;
+        for (uint8_t i = 1; i < code; i++)
+        {
+            dst[out++] = src[in++];
+        }
+        if (code != 0xFF && in < len)
+            dst[out++] = 0;
+    }
+    return out;
+}
+
+_Static_assert(PROTO_TRACE_PAYLOAD(PROTO_TRACE_EVENTS) <= PROTO_MAX_PAYLOAD, "trace packet too long");
+_Static_assert(PROTO_LOG_PAYLOAD(PROTO_LOG_RECORDS) <= PROTO_MAX_PAYLOAD, "log packet too long");
+_Static_assert(PROTO_DEPTH_PAYLOAD(TMF8821_ZONES_MAX) <= PROTO_MAX_PAYLOAD, "depth packet too long");
+_Static_assert(PROTO_HIST_PAYLOAD <= PROTO_MAX_PAYLOAD, "hist packet too long");
+
+static void proto_put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+static uint32_t proto_get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// 写公共头部: type(含传感器序号或核号) seq timestamp
+static void proto_put_header(uint8_t *payload, uint8_t type, uint8_t source, uint32_t ts, uint16_t seq)
+{
+    payload[0] = type | (source << 4);
+    payload[1] = seq & 0xFF;
+    payload[2] = seq >> 8;
+    proto_put32(&payload[3], ts);
+}
+
+// 追加CRC并COBS编码成线上数据包, 返回字节数
+// 包前后都放分隔符, 同一串口上夹杂的诊断文本只会坏掉它自己那一段
+static size_t proto_finish(uint8_t *payload, size_t len, uint8_t *packet)
+{
+    uint16_t crc = proto_crc16(payload, len);
+    payload[len] = crc & 0xFF;
+    payload[len + 1] = crc >> 8;
+
+    packet[0] = 0x00;
+    size_t n = 1 + proto_cobs_encode(payload, len + PROTO_CRC_SIZE, &packet[1]);
+    packet[n++] = 0x00;
+    return n;
+}
+
+// 把一帧结果打包成完整的线上数据包, 返回字节数
+size_t proto_encode_result(const result_frame_t *frame, uint16_t seq, uint8_t label, uint8_t *packet)
+{
+    uint8_t payload[PROTO_RESULT_PAYLOAD + PROTO_CRC_SIZE];
+
+    proto_put_header(payload, PROTO_TYPE_RESULT, frame->sensor, frame->timestamp_us, seq);
+    payload[7] = frame->frame.number;
+    payload[8] = frame->frame.temperature;
+    payload[9] = frame->frame.valid_results;
+    payload[10] = label;
+    memcpy(&payload[PROTO_HEADER_SIZE], frame->frame.objects, PROTO_RECORDS * 3);
+    return proto_finish(payload, PROTO_RESULT_PAYLOAD, packet);
+}
+
+// 把一个直方图包打包成线上数据包
+size_t proto_encode_hist(const result_frame_t *frame, uint16_t seq, uint8_t *packet)
+{
+    uint8_t payload[PROTO_HIST_PAYLOAD + PROTO_CRC_SIZE];
+
+    proto_put_header(payload, PROTO_TYPE_HIST, frame->sensor, frame->timestamp_us, seq);
+    payload[7] = frame->data[1]; // 包号
+    memcpy(&payload[PROTO_HIST_HEADER_SIZE], &frame->data[HIST_HEADER_SIZE], HIST_PACKET_DATA);
+    return proto_finish(payload, PROTO_HIST_PAYLOAD, packet);
+}
+
+// 把最多PROTO_TRACE_EVENTS个跟踪事件打包成线上数据包
+size_t proto_encode_trace(uint8_t core, uint16_t seq, uint32_t timestamp_us, const trace_event_t *events,
+                          uint8_t count, uint8_t *packet)
+{
+    uint8_t payload[PROTO_TRACE_PAYLOAD(PROTO_TRACE_EVENTS) + PROTO_CRC_SIZE];
+
+    if (count > PROTO_TRACE_EVENTS)
+        count = PROTO_TRACE_EVENTS;
+    proto_put_header(payload, PROTO_TYPE_TRACE, core, timestamp_us, seq);
+    payload[7] = count;
+    uint8_t *p = &payload[PROTO_TRACE_HEADER_SIZE];
+    for (uint8_t i = 0; i < count; i++, p += 8)
+    {
+        uint32_t t = events[i].t_us;
+        p[0] = t & 0xFF;
+        p[1] = (t >> 8) & 0xFF;
+        p[2] = (t >> 16) & 0xFF;
+        p[3] = t >> 24;
+        p[4] = events[i].id;
+        p[5] = events[i].a8;
+        p[6] = events[i].a16 & 0xFF;
+        p[7] = events[i].a16 >> 8;
+    }
+    return proto_finish(payload, PROTO_TRACE_PAYLOAD(count), packet);
+}
+
+// 把拼好的一幅深度图打包, 只带rows×cols个区
+size_t proto_encode_depth(const depth_frame_t *frame, uint8_t sensor, uint16_t seq, uint8_t *packet)
+{
+    uint8_t payload[PROTO_DEPTH_PAYLOAD(TMF8821_ZONES_MAX) + PROTO_CRC_SIZE];
+    uint8_t zones = frame->rows * frame->cols;
+
+    proto_put_header(payload, PROTO_TYPE_DEPTH, sensor, frame->timestamp_us, seq);
+    payload[7] = frame->number;
+    payload[8] = frame->spad_map_id;
+    payload[9] = frame->rows;
+    payload[10] = frame->cols;
+    uint8_t *p = &payload[PROTO_HEADER_SIZE];
+    for (int o = 0; o < RESULT_OBJECTS; o++, p += zones * 3)
+        memcpy(p, frame->zones[o], zones * 3);
+    return proto_finish(payload, PROTO_DEPTH_PAYLOAD(zones), packet);
+}
+
+// 点云包, 点数由调用方保证不超过POINT_CLOUD_MAX
+size_t proto_encode_points(const depth_frame_t *frame, const point_t *points, uint8_t count, uint8_t sensor,
+                           uint16_t seq, uint8_t *packet)
+{
+    uint8_t payload[PROTO_POINTS_PAYLOAD(POINT_CLOUD_MAX) + PROTO_CRC_SIZE];
+
+    proto_put_header(payload, PROTO_TYPE_POINTS, sensor, frame->timestamp_us, seq);
+    payload[7] = frame->number;
+    payload[8] = frame->spad_map_id;
+    payload[9] = count;
+    uint8_t *p = &payload[PROTO_POINTS_HEADER_SIZE];
+    for (uint8_t i = 0; i < count; i++, p += 8)
+    {
+        p[0] = points[i].zone;
+        p[1] = points[i].confidence;
+        p[2] = points[i].x & 0xFF;
+        p[3] = (uint16_t)points[i].x >> 8;
+        p[4] = points[i].y & 0xFF;
+        p[5] = (uint16_t)points[i].y >> 8;
+        p[6] = points[i].z & 0xFF;
+        p[7] = (uint16_t)points[i].z >> 8;
+    }
+    return proto_finish(payload, PROTO_POINTS_PAYLOAD(count), packet);
+}
+
+// 把一批日志记录打包, 最多PROTO_LOG_RECORDS条
+size_t proto_encode_log(uint8_t core, uint16_t seq, uint32_t timestamp_us, const log_record_t *records,
+                        uint8_t count, uint8_t *packet)
+{
+    uint8_t payload[PROTO_LOG_PAYLOAD(PROTO_LOG_RECORDS) + PROTO_CRC_SIZE];
+
+    if (count > PROTO_LOG_RECORDS)
+        count = PROTO_LOG_RECORDS;
+    proto_put_header(payload, PROTO_TYPE_LOG, core, timestamp_us, seq);
+    payload[7] = count;
+    uint8_t *p = &payload[PROTO_LOG_HEADER_SIZE];
+    for (uint8_t i = 0; i < count; i++)
+    {
+        proto_put32(p, records[i].t_us);
+        p[4] = records[i].id;
+        p[5] = records[i].suppressed;
+        p += 6;
+        for (int a = 0; a < LOG_ARGS; a++, p += 4)
+            proto_put32(p, records[i].args[a]);
+    }
+    return proto_finish(payload, PROTO_LOG_PAYLOAD(count), packet);
+}
+
+// 校验已解码载荷末尾的CRC
+bool proto_check(const uint8_t *payload, size_t len)
+{
+    if (len <= PROTO_CRC_SIZE + 7)
+        return false;
+    len -= PROTO_CRC_SIZE;
+    uint16_t crc = payload[len] | (payload[len + 1] << 8);
+    return proto_crc16(payload, len) == crc;
+}
+
+static uint32_t proto_get_ts(const uint8_t *payload)
+{
+    return proto_get32(&payload[3]);
+}
+
+// 解析已通过proto_check的结果包
+bool proto_parse_result(const uint8_t *payload, size_t len, proto_result_t *out)
+{
+    if (len != PROTO_RESULT_PAYLOAD + PROTO_CRC_SIZE || (payload[0] & PROTO_TYPE_MASK) != PROTO_TYPE_RESULT)
+        return false;
+
+    out->type = payload[0] & PROTO_TYPE_MASK;
+    out->sensor = payload[0] >> 4;
+    out->seq = payload[1] | (payload[2] << 8);
+    out->timestamp_us = proto_get_ts(payload);
+    out->result_number = payload[7];
+    out->temperature = (int8_t)payload[8];
+    out->valid = payload[9];
+    out->label = payload[10];
+    const uint8_t *rec = &payload[PROTO_HEADER_SIZE];
+    for (int i = 0; i < PROTO_RECORDS; i++, rec += 3)
+    {
+        out->confidence[i] = rec[0];
+        out->distance_mm[i] = rec[1] | (rec[2] << 8);
+    }
+    return true;
+}
+
+// 解析已通过proto_check的直方图包
+bool proto_parse_hist(const uint8_t *payload, size_t len, proto_hist_packet_t *out)
+{
+    if (len != PROTO_HIST_PAYLOAD + PROTO_CRC_SIZE || (payload[0] & PROTO_TYPE_MASK) != PROTO_TYPE_HIST ||
+        payload[7] >= HIST_PACKETS)
+        return false;
+
+    out->sensor = payload[0] >> 4;
+    out->seq = payload[1] | (payload[2] << 8);
+    out->timestamp_us = proto_get_ts(payload);
+    out->index = payload[7];
+    memcpy(out->data, &payload[PROTO_HIST_HEADER_SIZE], HIST_PACKET_DATA);
+    return true;
+}
+
+// 解析已通过proto_check的跟踪包
+bool proto_parse_trace(const uint8_t *payload, size_t len, proto_trace_t *out)
+{
+    if ((payload[0] & PROTO_TYPE_MASK) != PROTO_TYPE_TRACE || payload[7] > PROTO_TRACE_EVENTS ||
+        len != (size_t)PROTO_TRACE_PAYLOAD(payload[7]) + PROTO_CRC_SIZE)
+        return false;
+
+    out->core = payload[0] >> 4;
+    out->seq = payload[1] | (payload[2] << 8);
+    out->timestamp_us = proto_get_ts(payload);
+    out->count = payload[7];
+    const uint8_t *p = &payload[PROTO_TRACE_HEADER_SIZE];
+    for (uint8_t i = 0; i < out->count; i++, p += 8)
+    {
+        out->events[i].t_us = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+        out->events[i].id = p[4];
+        out->events[i].a8 = p[5];
+        out->events[i].a16 = p[6] | (p[7] << 8);
+    }
+    return true;
+}
+
+// 解析已通过proto_check的日志包
+bool proto_parse_log(const uint8_t *payload, size_t len, proto_log_t *out)
+{
+    if ((payload[0] & PROTO_TYPE_MASK) != PROTO_TYPE_LOG || payload[7] > PROTO_LOG_RECORDS ||
+        len != (size_t)PROTO_LOG_PAYLOAD(payload[7]) + PROTO_CRC_SIZE)
+        return false;
+
+    out->core = payload[0] >> 4;
+    out->seq = payload[1] | (payload[2] << 8);
+    out->timestamp_us = proto_get_ts(payload);
+    out->count = payload[7];
+    const uint8_t *p = &payload[PROTO_LOG_HEADER_SIZE];
+    for (uint8_t i = 0; i < out->count; i++)
+    {
+        out->records[i].t_us = proto_get32(p);
+        out->records[i].id = p[4];
+        out->records[i].suppressed = p[5];
+        p += 6;
+        for (int a = 0; a < LOG_ARGS; a++, p += 4)
+            out->records[i].args[a] = proto_get32(p);
+    }
+    return true;
+}
+
+// 解析已通过proto_check的深度图包
+bool proto_parse_depth(const uint8_t *payload, size_t len, proto_depth_t *out)
+{
+    if (len < PROTO_HEADER_SIZE + PROTO_CRC_SIZE) // 行列数在头里, 先确认头完整
+        return false;
+    unsigned zones = payload[9] * payload[10];
+    if ((payload[0] & PROTO_TYPE_MASK) != PROTO_TYPE_DEPTH || zones > TMF8821_ZONES_MAX ||
+        len != PROTO_DEPTH_PAYLOAD(zones) + PROTO_CRC_SIZE)
+        return false;
+
+    out->sensor = payload[0] >> 4;
+    out->seq = payload[1] | (payload[2] << 8);
+    out->frame.timestamp_us = proto_get_ts(payload);
+    out->frame.number = payload[7];
+    out->frame.spad_map_id = payload[8];
+    out->frame.rows = payload[9];
+    out->frame.cols = payload[10];
+    const uint8_t *p = &payload[PROTO_HEADER_SIZE];
+    for (int o = 0; o < RESULT_OBJECTS; o++, p += zones * 3)
+        memcpy(out->frame.zones[o], p, zones * 3);
+    return true;
+}
+
+// 解析已通过proto_check的点云包
+bool proto_parse_points(const uint8_t *payload, size_t len, proto_points_t *out)
+{
+    if (len < PROTO_POINTS_HEADER_SIZE + PROTO_CRC_SIZE)
+        return false;
+    uint8_t count = payload[9];
+    if ((payload[0] & PROTO_TYPE_MASK) != PROTO_TYPE_POINTS || count > POINT_CLOUD_MAX ||
+        len != (size_t)PROTO_POINTS_PAYLOAD(count) + PROTO_CRC_SIZE)
+        return false;
+
+    out->sensor = payload[0] >> 4;
+    out->seq = payload[1] | (payload[2] << 8);
+    out->timestamp_us = proto_get_ts(payload);
+    out->result_number = payload[7];
+    out->spad_map_id = payload[8];
+    out->count = count;
+    const uint8_t *p = &payload[PROTO_POINTS_HEADER_SIZE];
+    for (uint8_t i = 0; i < count; i++, p += 8)
+    {
+        out->points[i].zone = p[0];
+        out->points[i].confidence = p[1];
+        out->points[i].x = (int16_t)(p[2] | (p[3] << 8));
+        out->points[i].y = (int16_t)(p[4] | (p[5] << 8));
+        out->points[i].z = (int16_t)(p[6] | (p[7] << 8));
+    }
+    return true;
+}
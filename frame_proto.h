@@ -0,0 +1,138 @@
+#ifndef FRAME_PROTO_H
+#define FRAME_PROTO_H
+
+#include "frame_queue.h"
+#include "trace.h"
+#include "log.h"
+#include "depth_frame.h"
+#include "point_cloud.h"
+
+// 二进制输出协议: 每包 = 0x00 + COBS(载荷 + CRC16) + 0x00
+// 所有载荷(小端)以 type(1) seq(2) timestamp_us(4) 开头, seq对所有类型和传感器连续编号
+// type低4位为包类型, 高4位为传感器序号
+// 结果包: result_number(1) temperature(1) valid(1) label(1)
+//   然后 9区×2目标 的结果记录, 与传感器结果页相同: 置信度(1) 距离mm(2)
+// 直方图包: index(1) 然后128字节, 含义同传感器直方图包
+// 跟踪包: type高4位为核号, timestamp为导出时间; count(1) 然后count个事件:
+//   t_us(4) id(1) a8(1) a16(2)
+// 日志包: type高4位为核号, timestamp为发送时间; count(1) 然后count条记录:
+//   t_us(4) id(1) suppressed(1) args(3×4), 主机按log.c的消息表格式化
+// 深度图包(分时复用模式拼好的一幅): result_number(1) spad_map(1) rows(1) cols(1)
+//   然后rows×cols区的第一目标、再rows×cols区的第二目标, 记录同结果包; 区为行优先
+// 点云包(一幅的有效目标转成的点, 见point_cloud.h): result_number(1) spad_map(1) count(1)
+//   然后count个点: zone(1) confidence(1) x(2) y(2) z(2), 有符号mm
+#define PROTO_TYPE_RESULT 0x01
+#define PROTO_TYPE_HIST 0x02
+#define PROTO_TYPE_TRACE 0x03
+#define PROTO_TYPE_LOG 0x04
+#define PROTO_TYPE_DEPTH 0x05
+#define PROTO_TYPE_POINTS 0x06
+#define PROTO_TYPE_MASK 0x0F
+#define PROTO_HEADER_SIZE 11
+#define PROTO_RECORDS (RESULT_ZONES * RESULT_OBJECTS)
+#define PROTO_RESULT_PAYLOAD (PROTO_HEADER_SIZE + PROTO_RECORDS * 3)
+#define PROTO_HIST_HEADER_SIZE 8
+#define PROTO_HIST_PAYLOAD (PROTO_HIST_HEADER_SIZE + HIST_PACKET_DATA)
+#define PROTO_TRACE_EVENTS 16
+#define PROTO_TRACE_HEADER_SIZE 8
+#define PROTO_TRACE_PAYLOAD(n) (PROTO_TRACE_HEADER_SIZE + (n) * 8)
+#define PROTO_LOG_RECORDS 7
+#define PROTO_LOG_HEADER_SIZE 8
+#define PROTO_LOG_RECORD_SIZE (6 + LOG_ARGS * 4)
+#define PROTO_LOG_PAYLOAD(n) (PROTO_LOG_HEADER_SIZE + (n) * PROTO_LOG_RECORD_SIZE)
+#define PROTO_DEPTH_PAYLOAD(zones) (PROTO_HEADER_SIZE + (zones) * RESULT_OBJECTS * 3)
+#define PROTO_POINTS_HEADER_SIZE 10
+#define PROTO_POINTS_PAYLOAD(n) (PROTO_POINTS_HEADER_SIZE + (n) * 8)
+#define PROTO_MAX_PAYLOAD PROTO_POINTS_PAYLOAD(POINT_CLOUD_MAX) // 其余类型都短于满幅的点云包
+#define PROTO_CRC_SIZE 2
+#define PROTO_MAX_PACKET (PROTO_MAX_PAYLOAD + PROTO_CRC_SIZE + (PROTO_MAX_PAYLOAD + PROTO_CRC_SIZE) / 254 + 3)
+
+// 液体分类标签
+#define PROTO_LABEL_UNKNOWN 0
+#define PROTO_LABEL_SPORTS_DRINK 1
+#define PROTO_LABEL_WATER 2
+#define PROTO_LABEL_COLA 3
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t sensor;
+    uint16_t seq;
+    uint32_t timestamp_us;
+    uint8_t result_number;
+    int8_t temperature;
+    uint8_t valid;
+    uint8_t label;
+    uint8_t confidence[PROTO_RECORDS];
+    uint16_t distance_mm[PROTO_RECORDS];
+} proto_result_t;
+
+typedef struct
+{
+    uint8_t sensor;
+    uint16_t seq;
+    uint32_t timestamp_us;
+    uint8_t index;
+    uint8_t data[HIST_PACKET_DATA];
+} proto_hist_packet_t;
+
+typedef struct
+{
+    uint8_t core;
+    uint16_t seq;
+    uint32_t timestamp_us;
+    uint8_t count;
+    trace_event_t events[PROTO_TRACE_EVENTS];
+} proto_trace_t;
+
+typedef struct
+{
+    uint8_t core;
+    uint16_t seq;
+    uint32_t timestamp_us;
+    uint8_t count;
+    log_record_t records[PROTO_LOG_RECORDS];
+} proto_log_t;
+
+typedef struct
+{
+    uint8_t sensor;
+    uint16_t seq;
+    depth_frame_t frame;
+} proto_depth_t;
+
+typedef struct
+{
+    uint8_t sensor;
+    uint16_t seq;
+    uint32_t timestamp_us;
+    uint8_t result_number;
+    uint8_t spad_map_id;
+    uint8_t count;
+    point_t points[POINT_CLOUD_MAX];
+} proto_points_t;
+
+uint16_t proto_crc16(const uint8_t *data, size_t len);
+size_t proto_cobs_encode(const uint8_t *src, size_t len, uint8_t *dst);
+size_t proto_cobs_decode(const uint8_t *src, size_t len, uint8_t *dst);
+
+size_t proto_encode_result(const result_frame_t *frame, uint16_t seq, uint8_t label, uint8_t *packet);
+size_t proto_encode_hist(const result_frame_t *frame, uint16_t seq, uint8_t *packet);
+size_t proto_encode_trace(uint8_t core, uint16_t seq, uint32_t timestamp_us, const trace_event_t *events,
+                          uint8_t count, uint8_t *packet);
+size_t proto_encode_depth(const depth_frame_t *frame, uint8_t sensor, uint16_t seq, uint8_t *packet);
+size_t proto_encode_points(const depth_frame_t *frame, const point_t *points, uint8_t count, uint8_t sensor,
+                           uint16_t seq, uint8_t *packet);
+size_t proto_encode_log(uint8_t core, uint16_t seq, uint32_t timestamp_us, const log_record_t *records,
+                        uint8_t count, uint8_t *packet);
+
+// 解码端: 先用proto_check校验CRC, 再按payload[0]的类型解析
+bool proto_check(const uint8_t *payload, size_t len);
+bool proto_parse_result(const uint8_t *payload, size_t len, proto_result_t *out);
+bool proto_parse_hist(const uint8_t *payload, size_t len, proto_hist_packet_t *out);
+bool proto_parse_trace(const uint8_t *payload, size_t len, proto_trace_t *out);
+bool proto_parse_log(const uint8_t *payload, size_t len, proto_log_t *out);
+bool proto_parse_depth(const uint8_t *payload, size_t len, proto_depth_t *out);
+bool proto_parse_points(const uint8_t *payload, size_t len, proto_points_t *out);
+
+#endif
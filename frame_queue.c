@@ -0,0 +1,78 @@
+#include <string.h>
+#include "frame_queue.h"
+
+// 获取下一个空槽, 队列满时返回NULL并计为溢出
+result_frame_t *frame_queue_claim(frame_queue_t *q)
+{
+    uint32_t head = q->head;
+    if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) >= FRAME_QUEUE_LEN)
+    {
+        q->overflows++;
+        q->dropped++;
+        return NULL;
+    }
+    result_frame_t *slot = &q->slots[head & (FRAME_QUEUE_LEN - 1)];
+    slot->sensor = 0; // 可能是作废过的预留槽
+    return slot;
+}
+
+// 发布已填好的槽, 之后消费者才能看到这一帧
+void frame_queue_commit(frame_queue_t *q)
+{
+    __atomic_store_n(&q->head, q->head + 1, __ATOMIC_RELEASE);
+    q->reserved = q->head;
+}
+
+// 放弃已获取的槽(例如读到的不是结果页)
+void frame_queue_discard(frame_queue_t *q)
+{
+    q->dropped++;
+}
+
+// 预留下一个空槽, 数据由DMA直接写入; 队列满时返回NULL并计为溢出
+result_frame_t *frame_queue_reserve(frame_queue_t *q)
+{
+    uint32_t pos = q->reserved;
+    if (pos - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) >= FRAME_QUEUE_LEN)
+    {
+        q->overflows++;
+        q->dropped++;
+        return NULL;
+    }
+    result_frame_t *slot = &q->slots[pos & (FRAME_QUEUE_LEN - 1)];
+    slot->sensor = FRAME_SLOT_PENDING;
+    q->reserved = pos + 1;
+    return slot;
+}
+
+// 预留的槽已写完(ok为false时作废), 然后把head推过开头所有已完成的槽
+void frame_queue_complete(frame_queue_t *q, result_frame_t *slot, bool ok)
+{
+    if (!ok)
+    {
+        slot->sensor = FRAME_SLOT_EMPTY;
+        q->dropped++;
+    }
+    uint32_t head = q->head;
+    while (head != q->reserved && q->slots[head & (FRAME_QUEUE_LEN - 1)].sensor != FRAME_SLOT_PENDING)
+        head++;
+    __atomic_store_n(&q->head, head, __ATOMIC_RELEASE);
+}
+
+// 取出最多max帧, 返回实际帧数; 作废的预留槽直接跳过
+uint32_t frame_queue_read(frame_queue_t *q, result_frame_t *out, uint32_t max)
+{
+    uint32_t tail = q->tail;
+    uint32_t n = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) - tail;
+    if (n > max)
+        n = max;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const result_frame_t *slot = &q->slots[(tail + i) & (FRAME_QUEUE_LEN - 1)];
+        if (slot->sensor != FRAME_SLOT_EMPTY)
+            memcpy(&out[count++], slot, sizeof(result_frame_t));
+    }
+    __atomic_store_n(&q->tail, tail + n, __ATOMIC_RELEASE);
+    return count;
+}
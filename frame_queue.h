@@ -0,0 +1,51 @@
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include "tmf8821.h"
+
+// 单生产者/单消费者无锁结果帧队列: 中断只负责采集, 主循环批量取出
+#define FRAME_QUEUE_LEN 64 // 必须是2的幂, 容得下一整组直方图包
+#define FRAME_SLOT_SIZE (HIST_PACKET_SIZE > RESULT_FRAME_SIZE ? HIST_PACKET_SIZE : RESULT_FRAME_SIZE)
+
+// 一个槽放一页原始数据: 结果页(data[0] == RESULT_PAGE_ID)或直方图包(HIST_PAGE_ID)
+typedef struct
+{
+    uint32_t timestamp_us; // 进入中断时的MCU时间
+    uint8_t sensor;        // 传感器序号, 预留槽里为FRAME_SLOT_*
+    uint8_t run;           // 测量批次(sensor_array_t.run), 区分重新开始测量前后的帧
+    uint8_t spad_map_id;   // 这一批测量用的SPAD图
+    union
+    {
+        uint8_t data[FRAME_SLOT_SIZE];
+        tmf8821_frame_t frame; // 结果页时按字段访问
+    };
+} result_frame_t;
+
+// 预留槽的sensor字段: 还在传输 / 传输失败, 发布后消费者跳过
+#define FRAME_SLOT_PENDING 0xFE
+#define FRAME_SLOT_EMPTY 0xFF
+
+typedef struct
+{
+    result_frame_t slots[FRAME_QUEUE_LEN];
+    uint32_t head;      // 仅生产者写
+    uint32_t tail;      // 仅消费者写
+    uint32_t reserved;  // 已预留到的位置, 仅生产者写; 没有预留中的槽时等于head
+    uint32_t overflows; // 队列满时到达的帧
+    uint32_t dropped;   // 丢弃的帧(队列满或读取无效)
+} frame_queue_t;
+
+// 生产者
+result_frame_t *frame_queue_claim(frame_queue_t *q);
+void frame_queue_commit(frame_queue_t *q);
+void frame_queue_discard(frame_queue_t *q);
+
+// 生产者, 多个DMA同时往不同槽里读: 按预留顺序发布, 完成顺序可以不同.
+// 有预留中的槽时不要再用claim/commit
+result_frame_t *frame_queue_reserve(frame_queue_t *q);
+void frame_queue_complete(frame_queue_t *q, result_frame_t *slot, bool ok);
+
+// 消费者
+uint32_t frame_queue_read(frame_queue_t *q, result_frame_t *out, uint32_t max);
+
+#endif
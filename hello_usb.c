@@ -1,125 +1,646 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
-#include "hardware/i2c.h"
+#include "pico/multicore.h"
+#include "pico/flash.h"
+#include "hardware/structs/systick.h"
+#include "hardware/sync.h"
 #include "tmf882x_image.h"
 #include "tmf8821.h"
+#include "frame_queue.h"
+#include "frame_proto.h"
+#include "depth_frame.h"
+#include "point_cloud.h"
+#include "usb_stream.h"
+#include "classifier.h"
+#include "zone_filter.h"
+#include "sensor_array.h"
+#include "frame_dma.h"
+#include "calib_store.h"
+#include "trace.h"
+#include "log.h"
+
+#define FRAME_BATCH 4
+#define LOAD_REPORT_US 1000000
+#define CONSOLE_BYTE_TIMEOUT_US 100000
+#define DMA_POLL_US 1000 // core1等命令时顺便检查卡死的DMA传输
+#define LOG_DRAIN_BATCH 4 // 每轮主循环最多格式化的日志条数
+
+// core0 -> core1 命令(经多核FIFO)
+#define CORE1_CMD_START 1
+#define CORE1_CMD_STOP 2
+#define CORE1_CMD_STANDBY 3 // 停测量并待机, 之后CORE1_CMD_START从待机恢复
+#define CORE1_CMD_CALIBRATE 4 // 工厂标定并存进flash
+#define CORE1_CMD_PROFILE 0x100 // 低8位为配置序号
+
+// 传感器表: 所在总线、工作地址、EN/INT引脚. 加传感器时EN/INT各用一个引脚,
+// 同一总线上地址互不相同, 工作地址为默认地址(0x41)的最多一个
+static tmf8821_dev_t sensors[] = {
+    {.bus = &i2c_pico_transports[0], .bus_hz = I2C_BUS_HZ, .addr = I2C_ADDRESS, .pin_en = 22, .pin_int = 21},
+};
+#define SENSOR_COUNT (sizeof(sensors) / sizeof(sensors[0]))
 
 extern const unsigned char tmf882x_image[];
-uint16_t res[27];
-uint8_t res_re=0;
+static sensor_array_t array;
+static frame_queue_t frames;
+static frame_dma_t dma; // 只在core1使用
+static calib_store_t calib; // 只在core1使用, 放在栈上太大
+static calib_store_t calib_new; // 新标定先放这里, 成功的项再并进calib, 失败的传感器保留原有标定
+static classifier_t classifier[SENSOR_COUNT]; // 只在core0使用
+static zone_filter_t filter[SENSOR_COUNT];
+static depth_assembler_t depth[SENSOR_COUNT]; // 只在core0使用, 见到新的测量批次时重新init
+static uint8_t depth_run[SENSOR_COUNT];       // 各拼装器对应的测量批次
+static uint32_t filter_cycles;   // SysTick计的滤波耗时, 随负载报告清零
+static uint32_t filter_frames;
+static bool point_output;         // 按p切换: 结果/深度图包换成点云包
+static point_t points[POINT_CLOUD_MAX]; // 只在core0使用, 放在栈上太大
+static uint32_t point_cycles;     // SysTick计的点云转换耗时, 随负载报告清零
+static uint32_t point_frames;
+static uint16_t packet_seq; // 数据口所有包共用的序号
+
+// 每个传感器的端到端统计: 结果编号跟踪丢帧(含队列溢出), 延迟从进中断到送进数据口
+// 只在core0使用, 随负载报告清零
+typedef struct
+{
+    tmf8821_seq_t seq;
+    uint32_t latency_sum_us;
+    uint32_t latency_max_us;
+    uint32_t late; // 延迟超过一个测量周期的帧
+} frame_stats_t;
+static frame_stats_t frame_stats[SENSOR_COUNT];
+static uint16_t stats_period_ms; // core0这边记的当前测量周期
+static bool stats_periodic;      // 每个周期都该有一帧(直方图模式会跳过周期, 停止和待机时没有帧)
+static uint8_t stats_profile;    // core0这边记的当前配置序号
+static uint32_t wakes_reported[SENSOR_COUNT];
+
+// 跟踪导出状态, 只在core0使用
+static bool trace_dumping;
+static uint8_t dump_core;
+static uint32_t dump_pos;
+
+// 日志输出方式, 只在core0使用: false为格式化到串口, true为原始记录打包到数据口
+static bool log_binary;
+
+// 各核忙碌时间(µs), 只由对应核写
+static volatile uint32_t core_busy_us[2];
+static volatile uint32_t int_missed; // 漏掉下降沿、由core1补服务的INT, 只由core1写
 
+// 中断(core1)里只把结果页或直方图包读进队列, 按INT引脚找到是哪个传感器
+// 结果模式下只排队, 由DMA取帧(frame_dma.c); 直方图模式用CPU读
+// 先读后清: 传感器在INT_HIST被清除后才送下一个直方图包
+// 帧时间戳在进中断的第一条语句取: GPIO没有输入捕获, 这是离INT下降沿最近的时刻;
+// 多个传感器的INT同时到来时, 后服务的那个晚一次中断耗时(见跟踪里的irq duration)
 void gpio_callback(uint gpio, uint32_t events)
 {
-    uint8_t dataa = 0;
-    i2c_write_byte(0xe1, i2c_read_byte(0xe1));
-    read_measurement_results((uint16_t *) res);
-  
-    printf("value:\n");
-    printf(" 0x%02X%02X\n", res[2], res[1]);
-    if(res[2]==0)
-    {
-        if((res[1]==0x53)||(res[1]==0x52))
-            printf("可能是运动饮料\n");
-        if((res[1]==0x55))
-            printf("可能是水\n");
-        if ((res[1] == 0x57) || (res[1] == 0x58))
-             printf("可能是可乐溶液\n");
+    uint32_t start = time_us_32();
+    (void)events; // 只注册了下降沿
+    int sensor = sensor_array_find_int(&array, gpio);
+    if (sensor < 0)
+        return;
+    TRACE(TRACE_IRQ_ENTER, sensor, gpio);
+    if (frame_dma_trigger(&dma, sensor, start))
+    {
+        TRACE(TRACE_IRQ_EXIT, sensor, 0);
+        core_busy_us[1] += time_us_32() - start;
+        return;
+    }
+    // 主循环可能正选着别的传感器, 用完恢复
+    tmf8821_selection_t prev;
+    tmf8821_save_selection(&prev);
+    tmf8821_select(&sensors[sensor]);
+    uint8_t status;
+    if (!i2c_read_bytes(INT_CLEAR_REG, &status, 1))
+        status = INT_HIST | INT_RESULT; // 不知道是哪个中断, 都清掉, 否则INT一直低着不会再有下降沿
+    else if (status & (INT_HIST | INT_RESULT))
+    {
+        result_frame_t *slot = frame_queue_claim(&frames);
+        if (slot != NULL)
+        {
+            slot->timestamp_us = start;
+            slot->sensor = sensor;
+            slot->run = array.run;
+            slot->spad_map_id = array.spad_map_id;
+            bool ok = (status & INT_HIST) ? read_hist_packet(slot->data) : read_result_frame(slot->data);
+            if (ok)
+            {
+                if (status & INT_RESULT)
+                    tmf8821_power_frame(&sensors[sensor], start);
+                frame_queue_commit(&frames);
+                TRACE(TRACE_FRAME_READY, sensor, (status & INT_HIST) ? slot->data[1] : slot->data[4]);
+            }
+            else
+                frame_queue_discard(&frames);
+        }
+        else
+            TRACE(TRACE_FRAME_DROP, sensor, 0);
     }
+    i2c_write_byte(INT_CLEAR_REG, status);
+    tmf8821_restore_selection(&prev);
+    TRACE(TRACE_IRQ_EXIT, sensor, status);
+    core_busy_us[1] += time_us_32() - start;
 }
 
-int main()
+// INT是低电平有效、清了才放开, 而中断只按下降沿触发: 读帧彻底失败(DMA重试用完)或下降沿
+// 落在命令处理关中断的窗口里时, 这个传感器就再也不会有中断. core1空闲时每DMA_POLL_US检查一次,
+// 连续两次都是低电平且没有在取的传感器补做一次中断服务
+static void int_watchdog(void)
 {
-    stdio_init_all(); // 初始化标准I/O
-    i2c_init_bus();   // 初始化I²C总线
-    gpio_init(22);
-    gpio_set_dir(22, GPIO_OUT);
-    gpio_init(21);
-    gpio_set_dir(21, GPIO_IN);
-    gpio_put(22, 1);
-    i2c_write_byte(0xE0, 0x01);
+    static uint32_t low_before;
+    uint32_t low = 0;
+    uint32_t irq = save_and_disable_interrupts(); // 补服务要和真正的中断一样独占驱动和总线
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+    {
+        if (array.state[i] != SENSOR_READY || gpio_get(sensors[i].pin_int) || frame_dma_busy(&dma, i))
+            continue;
+        low |= 1u << i;
+        if (low_before & (1u << i))
+        {
+            int_missed++;
+            gpio_callback(sensors[i].pin_int, GPIO_IRQ_EDGE_FALL);
+            low &= ~(1u << i);
+        }
+    }
+    restore_interrupts(irq);
+    low_before = low;
+}
 
-    sleep_ms(5000); // 等待串口
+// 主循环里处理一帧: 滤波、分类后以二进制包送到数据CDC, 直方图包原样转发;
+// 分时复用的区模式不滤波、不分类, 子帧拼齐一幅后发深度图包.
+// 点云输出时3x3也经拼装(每页即一幅), 拼好的一幅转成点发点云包
+static void process_frame(result_frame_t *frame)
+{
+    uint8_t packet[PROTO_MAX_PACKET];
+    size_t n = 0;
 
-    printf("Checking device readiness...\n");
-    check_device_ready(); // 检查设备是否准备好通信
-    printf("register value: 0x%02X\n", i2c_read_byte(0));
+    if (frame->data[0] == HIST_PAGE_ID)
+    {
+        usb_stream_write(packet, proto_encode_hist(frame, packet_seq++, packet));
+        return;
+    }
 
-    uint8_t bu[5] = {0x08, 0x14, 0x01, 0x29, 0xc1};
-    i2c_write_blocking(I2C_PORT, I2C_ADDRESS, bu, 5, false);
-    uint8_t re = 0x08;
-    uint8_t dat[3];
-    uint8_t da[3];
-    uint8_t i = 0;
+    // core1每次(重新)开始测量都换批次号: 队列里还没处理的旧帧仍按旧的SPAD图拼,
+    // 新一批的子帧序号从它的第一帧重新数
+    depth_assembler_t *d = &depth[frame->sensor];
+    if (frame->run != depth_run[frame->sensor])
+    {
+        depth_assembler_init(d, tmf8821_find_spad_map(frame->spad_map_id));
+        depth_run[frame->sensor] = frame->run;
+    }
+    bool whole = d->map->sub_frames == 1;
+    if (whole)
+    {
+        uint32_t t0 = systick_hw->cvr;
+        zone_filter_apply(&filter[frame->sensor], frame->frame.objects);
+        filter_cycles += (t0 - systick_hw->cvr) & 0xFFFFFF; // 24位递减计数
+        filter_frames++;
 
-    check_cmd();
-    set_address(0x0000);
+        classifier_result_t result;
+        classifier_update(&classifier[frame->sensor], frame->frame.objects[0], &result);
+        if (!point_output)
+            n = proto_encode_result(frame, packet_seq++, result.label, packet);
+    }
+    if ((!whole || point_output) && depth_assembler_add(d, &frame->frame, frame->timestamp_us))
+    {
+        if (point_output)
+        {
+            uint32_t t0 = systick_hw->cvr;
+            uint8_t count = point_cloud_convert(&d->frame, points);
+            point_cycles += (t0 - systick_hw->cvr) & 0xFFFFFF;
+            point_frames++;
+            n = proto_encode_points(&d->frame, points, count, frame->sensor, packet_seq++, packet);
+        }
+        else
+            n = proto_encode_depth(&d->frame, frame->sensor, packet_seq++, packet);
+    }
+    if (n)
+        usb_stream_write(packet, n);
+    uint32_t latency = time_us_32() - frame->timestamp_us;
+    TRACE(TRACE_FRAME_OUT, frame->sensor, latency > 0xFFFF ? 0xFFFF : latency);
 
-    check_cmd();
+    frame_stats_t *st = &frame_stats[frame->sensor];
+    tmf8821_seq_update(&st->seq, frame->frame.number, frame->timestamp_us);
+    st->latency_sum_us += latency;
+    if (latency > st->latency_max_us)
+        st->latency_max_us = latency;
+    if (latency >= stats_period_ms * 1000u)
+        st->late++;
+}
+
+static void frame_stats_init(const tmf8821_config_t *config)
+{
+    stats_period_ms = config->period_ms;
+    stats_periodic = !config->hist_dump;
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+    {
+        frame_stats[i] = (frame_stats_t){0};
+        tmf8821_seq_init(&frame_stats[i].seq, config->period_ms);
+    }
+}
 
-    int ii = 0;
-    while (true)
+// 每个传感器一行: 跟得上 = 这段时间没有丢帧、没有帧晚于一个周期、数据口没有丢包
+// 完全收不到帧的传感器没有编号缺口, 按elapsed_us内应有的帧数补算丢帧
+static void frame_stats_report(uint32_t elapsed_us, uint32_t usb_dropped)
+{
+    uint32_t expected = stats_periodic ? elapsed_us / (stats_period_ms * 1000u) : 0;
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++)
     {
+        frame_stats_t *st = &frame_stats[i];
+        if (expected > st->seq.frames + st->seq.lost + 1)
+            st->seq.lost = expected - st->seq.frames;
+        bool keeping_up = st->seq.lost == 0 && st->late == 0 && usb_dropped == 0;
+        printf("sensor %u: %lu frames, %lu lost, latency avg %lu max %lu us, %lu late, %s\n", i,
+               (unsigned long)st->seq.frames, (unsigned long)st->seq.lost,
+               (unsigned long)(st->seq.frames ? st->latency_sum_us / st->seq.frames : 0),
+               (unsigned long)st->latency_max_us, (unsigned long)st->late,
+               keeping_up ? "keeping up" : "FALLING BEHIND");
+        st->seq.frames = 0;
+        st->seq.lost = 0;
+        st->seq.repeats = 0;
+        st->latency_sum_us = 0;
+        st->latency_max_us = 0;
+        st->late = 0;
 
-        write_ram((void *)(tmf882x_image + ii), 20);
-        check_cmd();
-        ii += 20;
-        if (ii == 2620)
+        // 分时复用的区模式另报有效帧率: 拼齐的深度图帧数/s和缺子帧作废的幅数
+        depth_assembler_t *d = &depth[i];
+        if (d->map->sub_frames > 1)
         {
-            write_ram((void *)(tmf882x_image + ii), 16);
-            sleep_ms(2);
-            break;
+            printf("sensor %u: %s %ux%u, %lu depth frames/s, %lu incomplete\n", i, d->map->name, d->map->rows,
+                   d->map->cols, (unsigned long)(elapsed_us ? d->frames * 1000000ull / elapsed_us : 0),
+                   (unsigned long)d->incomplete);
+            d->frames = 0;
+            d->incomplete = 0;
+        }
+
+        // 唤醒统计由core1写, 这里只读; 有新的唤醒且已等到首帧时报一次
+        const tmf8821_power_stats_t *p = &sensors[i].power;
+        if (p->wakes != wakes_reported[i] && p->first_frame_us)
+        {
+            printf("sensor %u: woke in %lu us, first frame %lu us after wake (max %lu)\n", i,
+                   (unsigned long)p->wake_us, (unsigned long)p->first_frame_us,
+                   (unsigned long)p->first_frame_max_us);
+            wakes_reported[i] = p->wakes;
         }
-        printf("%d\n", ii);
     }
+}
 
-    ram_remap_reset();
+// 导出跟踪缓冲: 't'暂停记录, 之后每轮主循环在数据口有空位时发一个跟踪包,
+// 不挤掉测量数据; 两个核的环都发完后清空并恢复记录
+static void trace_dump_task(void)
+{
+    if (!trace_dumping || !usb_stream_writable(PROTO_MAX_PACKET))
+        return;
 
-    // 等待设备重启并检查APPID
-    sleep_ms(3); // 等待2.5秒
-    uint8_t appid = i2c_read_byte(APPID_REG);
-    printf("APPID: 0x%02X\n", appid);
+    uint8_t packet[PROTO_MAX_PACKET];
+    trace_event_t events[PROTO_TRACE_EVENTS];
+    uint32_t n = trace_count(dump_core) - dump_pos;
+    if (n > PROTO_TRACE_EVENTS)
+        n = PROTO_TRACE_EVENTS;
+    for (uint32_t i = 0; i < n; i++)
+        events[i] = trace_get(dump_core, dump_pos + i);
+    dump_pos += n;
+    if (n)
+        usb_stream_write(packet, proto_encode_trace(dump_core, packet_seq++, time_us_32(), events, n, packet));
 
-    load_common_config();
-    uint8_t r = 0x20;
+    if (dump_pos == trace_count(dump_core))
+    {
+        dump_pos = 0;
+        if (++dump_core == TRACE_CORES)
+        {
+            trace_clear();
+            trace_pause(false);
+            trace_dumping = false;
+            printf("trace dumped\n");
+        }
+    }
+}
 
-    check_conf();
+// 驱动日志: 每轮主循环取几条, 格式化到串口或原样打包到数据口(主机用trace_report格式化)
+static void log_task(void)
+{
+    if (!log_binary)
+    {
+        log_drain(LOG_DRAIN_BATCH);
+        return;
+    }
+    for (uint8_t core = 0; core < LOG_CORES && usb_stream_writable(PROTO_MAX_PACKET); core++)
+    {
+        log_record_t records[PROTO_LOG_RECORDS];
+        uint8_t n = 0;
+        while (n < PROTO_LOG_RECORDS && log_take(core, &records[n]))
+            n++;
+        if (n)
+        {
+            uint8_t packet[PROTO_MAX_PACKET];
+            usb_stream_write(packet, proto_encode_log(core, packet_seq++, time_us_32(), records, n, packet));
+        }
+    }
+}
 
-    // 步骤2: 配置测量周期为100ms
-    set_measurement_period();
+// core1: 独占传感器, 负责初始化、结果中断和命令
+static void core1_main()
+{
+    for (uint8_t b = 0; b < I2C_PICO_BUSES; b++)
+    { // 初始化用到的I²C总线
+        for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+        {
+            if (sensors[i].bus == &i2c_pico_transports[b])
+            {
+                printf("I2C%u at %lu Hz\n", b, (unsigned long)i2c_pico_init(b, sensors[i].bus_hz));
+                break;
+            }
+        }
+    }
+    sensor_array_init(&array, sensors, SENSOR_COUNT);
 
-    // 步骤3: 选择SPAD掩码6
-    set_spad_mask();
-    i2c_write_byte(0x31, 0x03);
-    write_common_config();
+    // 依次上电、下载固件并改址; 仅MCU复位时热启动
+    const uint8_t app_version[3] = {TMF882X_IMAGE_APP_MAJOR, TMF882X_IMAGE_APP_MINOR, TMF882X_IMAGE_APP_PATCH};
+    int ready = sensor_array_bringup(&array, tmf882x_image, tmf882x_image_length, app_version);
+    printf("%d of %u sensors ready in %lu us\n", ready, (unsigned)SENSOR_COUNT, (unsigned long)array.bringup_us);
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+    {
+        tmf8821_boot_stats_t boot;
+        tmf8821_select(&sensors[i]);
+        tmf8821_get_boot_stats(&boot);
+        printf("Sensor %u at 0x%02X: %s, APPID 0x%02X\n", i, sensors[i].addr,
+               boot.warm_starts ? "warm start" : "cold start", i2c_read_byte(APPID_REG));
+    }
+
+    // 步骤2/3/5/6: 写入默认测量配置(周期、SPAD掩码、GPIO), 启用并清除结果中断
+    if (sensor_array_configure(&array, &tmf8821_profiles[0]) != TMF8821_OK)
+        printf("Writing common configuration failed.\n");
+
+    // 恢复存在flash里的工厂标定; 没有或损坏时以未标定状态运行, 可用'c'标定
+    if (calib_store_load(&calib, calib_flash_data(), CALIB_STORE_MAX))
+        printf("Calibration restored on %d of %u sensors\n",
+               calib_store_restore(&calib, &array, tmf8821_profiles[0].spad_map_id), (unsigned)SENSOR_COUNT);
+    else
+        printf("No valid stored calibration, running uncalibrated\n");
+
+    // 0x6E在各传感器上同时执行
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+    {
+        tmf8821_select(&sensors[i]);
+        if (array.state[i] == SENSOR_READY)
+            tmf8821_cmd_submit(0x6E, TMF8821_CMD_TIMEOUT_US, NULL, NULL);
+    }
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+    {
+        if (array.state[i] != SENSOR_READY)
+            continue;
+        tmf8821_select(&sensors[i]);
+        int result = tmf8821_cmd_wait();
+        printf("Sensor %u command 0x6E: %d, factory register 0x%02X\n", i, result, i2c_read_byte(0x07));
+    }
 
-    i2c_write_byte(CMD_STAT_REG, 0x6E); // 写入公共配置页面
-    while (i2c_read_byte(CMD_STAT_REG) != 0x00)
-    { // 等待命令完成
-        sleep_ms(10);
+    if (!frame_dma_init(&dma, &array, &frames))
+        printf("DMA acquisition unavailable, reading frames on the CPU\n");
+    frame_dma_enable(&dma, !tmf8821_profiles[0].hist_dump);
+
+    gpio_set_irq_enabled_with_callback(sensors[0].pin_int, GPIO_IRQ_EDGE_FALL, true, &gpio_callback);
+    for (uint8_t i = 1; i < SENSOR_COUNT; i++)
+        gpio_set_irq_enabled(sensors[i].pin_int, GPIO_IRQ_EDGE_FALL, true);
+
+    // 步骤7: 错开启动测量
+    const tmf8821_config_t *profile = &tmf8821_profiles[0];
+    bool standby = false;
+    sensor_array_start(&array, profile->period_ms);
+
+    while (1)
+    {
+        uint32_t cmd;
+        if (!multicore_fifo_pop_timeout_us(DMA_POLL_US, &cmd)) // 等待时中断照常响应
+        {
+            frame_dma_poll(&dma);
+            int_watchdog();
+            continue;
+        }
+        for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+            gpio_set_irq_enabled(sensors[i].pin_int, GPIO_IRQ_EDGE_FALL, false);
+        frame_dma_enable(&dma, false); // 做完在途的DMA才能用CPU访问总线
+        bool resumed = false;
+        if (standby && cmd != CORE1_CMD_STANDBY)
+        { // 其他命令先从待机恢复: 不重新下载和配置, 置PON后直接测量
+            sensor_array_resume(&array, profile->period_ms);
+            standby = false;
+            resumed = true;
+        }
+        if (cmd == CORE1_CMD_START && !resumed)
+        {
+            sensor_array_start(&array, profile->period_ms);
+        }
+        else if (cmd == CORE1_CMD_STOP)
+        {
+            sensor_array_stop(&array);
+        }
+        else if (cmd == CORE1_CMD_STANDBY && !standby)
+        {
+            sensor_array_standby(&array);
+            standby = true;
+        }
+        else if (cmd == CORE1_CMD_CALIBRATE)
+        { // 标定按当前配置的SPAD图做, 之后照常测量
+            sensor_array_stop(&array);
+            int n = calib_store_capture(&calib_new, &array, profile->spad_map_id);
+            calib_store_merge(&calib, &calib_new);
+            uint8_t blob[CALIB_STORE_MAX];
+            bool saved = n > 0 && calib_flash_write(blob, calib_store_save(&calib, blob));
+            printf("Calibrated %d of %u sensors, %s\n", n, (unsigned)SENSOR_COUNT, saved ? "saved to flash" : "NOT saved");
+            sensor_array_start(&array, profile->period_ms);
+        }
+        else if ((cmd & CORE1_CMD_PROFILE) && (cmd & 0xFF) < tmf8821_profile_count)
+        { // 运行中切换配置, 无需重启
+            profile = &tmf8821_profiles[cmd & 0xFF];
+            sensor_array_stop(&array);
+            sensor_array_configure(&array, profile);
+            calib_store_restore(&calib, &array, profile->spad_map_id);
+            sensor_array_start(&array, profile->period_ms);
+        }
+        frame_dma_enable(&dma, !profile->hist_dump);
+        for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+            gpio_set_irq_enabled(sensors[i].pin_int, GPIO_IRQ_EDGE_FALL, true);
     }
+}
 
-    printf("Check factory register value: 0x%02X\n", i2c_read_byte(0x07));
+// 从诊断口读入一张标定表: 先读表头得到长度, 再读其余部分
+static void load_classifier_table(void)
+{
+    uint8_t blob[CLASSIFIER_BLOB_MAX];
+    size_t len = CLASSIFIER_BLOB_HEADER;
+    for (size_t i = 0; i < len; i++)
+    {
+        int c = getchar_timeout_us(CONSOLE_BYTE_TIMEOUT_US);
+        if (c < 0)
+        {
+            printf("classifier table: timeout after %u bytes\n", (unsigned)i);
+            return;
+        }
+        blob[i] = (uint8_t)c;
+        if (i == 1 && blob[1] <= CLASSIFIER_MAX_CLASSES)
+            len = CLASSIFIER_BLOB_SIZE(blob[1]);
+    }
 
-    // 步骤5: 启用结果中断
-    enable_interrupts();
+    classifier_table_t table;
+    if (!classifier_load(&table, blob, len))
+    {
+        printf("classifier table rejected\n");
+        return;
+    }
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+        classifier_init(&classifier[i], &table);
+    printf("classifier table loaded: %u classes, zones 0x%03X\n", table.count, table.zone_mask);
+}
 
-    // 步骤6: 清除中断
-    clear_interrupts();
+// core0: 处理结果并通过USB输出
+int main()
+{
+    stdio_init_all(); // 初始化标准I/O
+    usb_stream_init(); // CDC0诊断, CDC1数据
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+    {
+        classifier_init(&classifier[i], &classifier_default_table);
+        zone_filter_init(&filter[i], ZONE_FILTER_NONE);
+        depth_assembler_init(&depth[i], tmf8821_find_spad_map(tmf8821_profiles[0].spad_map_id));
+    }
+    frame_stats_init(&tmf8821_profiles[0]);
+    systick_hw->rvr = 0xFFFFFF; // core0 SysTick按CPU时钟自由计数
+    systick_hw->csr = 0x5;
 
-    gpio_set_irq_enabled_with_callback(21, GPIO_IRQ_EDGE_FALL, true, &gpio_callback);
+    uint32_t wait_start = time_us_32();
+    while (time_us_32() - wait_start < 5000000)
+    { // 等待串口, 期间照常处理USB
+        usb_stream_task();
+    }
 
-    // 步骤7: 启动测量
-    start_measurement();
+    flash_safe_execute_core_init(); // core1写标定时core0要能停在RAM里
+    multicore_launch_core1(core1_main);
 
+    result_frame_t batch[FRAME_BATCH];
+    uint32_t dropped = 0;
+    uint32_t processed = 0;
+    uint32_t report_start = time_us_32();
+    uint32_t busy_mark[2] = {0, 0};
+    uint32_t usb_dropped_mark = 0;
+    uint32_t log_lost_mark = 0;
+    usb_stream_stats_t usb;
     while (1)
     {
-        // printf("%d",res_re);
-        if(res_re==1)
+        usb_stream_task();
+        uint32_t n = frame_queue_read(&frames, batch, FRAME_BATCH);
+        uint32_t start = time_us_32();
+        for (uint32_t k = 0; k < n; k++)
+        {
+            process_frame(&batch[k]);
+        }
+        processed += n;
+        core_busy_us[0] += time_us_32() - start;
+        if (frames.dropped != dropped)
+        {
+            dropped = frames.dropped;
+            printf("frames dropped: %lu (overflows: %lu)\n", (unsigned long)dropped, (unsigned long)frames.overflows);
+        }
+
+        trace_dump_task();
+        log_task();
+
+        // 串口命令: s 停止测量, g 开始测量(待机时恢复), z 待机, 0-9 切换测量配置, k 后跟标定表,
+        // f 切换滤波, t 导出跟踪, c 工厂标定(40cm内无目标、环境光暗), l 切换日志为文本/二进制,
+        // p 切换点云输出
+        int c = getchar_timeout_us(0);
+        if (c == 's' || c == 'z')
+        {
+            multicore_fifo_push_blocking(c == 's' ? CORE1_CMD_STOP : CORE1_CMD_STANDBY);
+            stats_periodic = false;
+        }
+        else if (c == 'g')
+        {
+            multicore_fifo_push_blocking(CORE1_CMD_START);
+            frame_stats_init(&tmf8821_profiles[stats_profile]);
+        }
+        else if (c >= '0' && c <= '9')
+        {
+            multicore_fifo_push_blocking(CORE1_CMD_PROFILE | (c - '0'));
+            for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+                classifier_reset(&classifier[i]);
+            if (c - '0' < tmf8821_profile_count)
+            {
+                stats_profile = c - '0';
+                frame_stats_init(&tmf8821_profiles[stats_profile]);
+            }
+        }
+        else if (c == 'c')
+            multicore_fifo_push_blocking(CORE1_CMD_CALIBRATE);
+        else if (c == 'k')
+            load_classifier_table();
+        else if (c == 'f')
+        {
+            zone_filter_mode_t mode = (filter[0].mode + 1) % ZONE_FILTER_MODES;
+            for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+            {
+                zone_filter_init(&filter[i], mode);
+                classifier_reset(&classifier[i]);
+            }
+            printf("filter: %s\n", zone_filter_names[mode]);
+        }
+        else if (c == 'l')
+        {
+            log_binary = !log_binary;
+            printf("log: %s\n", log_binary ? "binary on data port" : "text");
+        }
+        else if (c == 'p')
+        {
+            point_output = !point_output;
+            printf("output: %s\n", point_output ? "point cloud" : "results");
+        }
+        else if (c == 't' && !trace_dumping)
+        {
+            printf("trace: %lu + %lu events\n", (unsigned long)trace_count(0), (unsigned long)trace_count(1));
+            trace_pause(true);
+            trace_dumping = true;
+            dump_core = 0;
+            dump_pos = 0;
+        }
+
+        uint32_t elapsed = time_us_32() - report_start;
+        if (elapsed >= LOAD_REPORT_US)
         {
-            printf("value: 0x%02X%02X\n", res[1], res[2]);
-            res_re=0;
+            uint32_t busy0 = core_busy_us[0] - busy_mark[0];
+            uint32_t busy1 = core_busy_us[1] + dma.irq_us - busy_mark[1]; // GPIO中断 + DMA完成中断
+            usb_stream_get_stats(&usb);
+            printf("load: core0 %lu%%, core1 %lu%%, %lu frames/s, usb %lu bytes, %lu packets dropped\n",
+                   (unsigned long)(busy0 * 100ull / elapsed), (unsigned long)(busy1 * 100ull / elapsed),
+                   (unsigned long)(processed * 1000000ull / elapsed), (unsigned long)usb.bytes_sent,
+                   (unsigned long)usb.packets_dropped);
+            if (filter_frames)
+                printf("filter %s: %lu cycles/frame\n", zone_filter_names[filter[0].mode],
+                       (unsigned long)(filter_cycles / filter_frames));
+            if (point_frames)
+                printf("points: %lu cycles/frame\n", (unsigned long)(point_cycles / point_frames));
+            i2c_stats_t bus;
+            i2c_get_stats(&bus); // core1的计数, 这里只读
+            if (bus.nacks || bus.timeouts)
+                printf("i2c: %lu nacks, %lu timeouts, %lu retries, %lu recoveries, %lu failed\n",
+                       (unsigned long)bus.nacks, (unsigned long)bus.timeouts, (unsigned long)bus.retries,
+                       (unsigned long)bus.recoveries, (unsigned long)bus.failures);
+            if (dma.aborts)
+                printf("dma: %lu frames, %lu aborts, %lu failed\n", (unsigned long)dma.frames,
+                       (unsigned long)dma.aborts, (unsigned long)dma.failures);
+            if (int_missed)
+                printf("int: %lu missed edges serviced late\n", (unsigned long)int_missed);
+            if (log_lost() != log_lost_mark)
+            {
+                log_lost_mark = log_lost();
+                printf("log: %lu records lost\n", (unsigned long)log_lost_mark);
+            }
+            frame_stats_report(elapsed, usb.packets_dropped - usb_dropped_mark);
+            usb_dropped_mark = usb.packets_dropped;
+            filter_cycles = 0;
+            filter_frames = 0;
+            point_cycles = 0;
+            point_frames = 0;
+            busy_mark[0] = core_busy_us[0];
+            busy_mark[1] = core_busy_us[1] + dma.irq_us;
+            processed = 0;
+            report_start = time_us_32();
         }
-        
     }
 
     return 0;
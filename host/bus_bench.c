@@ -0,0 +1,280 @@
+// 总线开销基准: 在模拟TMF8821上跑与main()相同的启动流程和结果读取,
+// 统计各阶段的I²C事务数、线上字节数和按总线时钟估算的总线时间.
+// 结果读取先按原来的逐字节方式跑一遍, 再用整页突发读跑一遍, 两种每帧开销在同一次运行里对比.
+// 用法: bus_bench [bus_hz] [frames]   驱动日志走stdout, 报告走stderr
+
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "tmf8821.h"
+#include "frame_queue.h"
+#include "tmf882x_image.h"
+#include "tmf8821_sim.h"
+#include "frame_proto.h"
+#include "frame_decoder.h"
+#include "log.h"
+
+static tmf8821_sim_t sim;
+static frame_queue_t queue;
+static i2c_stats_t phase_stats;
+static uint64_t phase_start_us;
+static bool per_byte; // 按原来的方式逐字节读结果
+
+static void phase_begin(void)
+{
+    i2c_reset_stats();
+    phase_start_us = time_us_64();
+}
+
+static void phase_end(const char *name, uint32_t div)
+{
+    i2c_get_stats(&phase_stats);
+    uint64_t elapsed = time_us_64() - phase_start_us;
+    fprintf(stderr, "%-10s %8.1f tx %9.1f bytes %10.1f us bus %10.1f us elapsed\n", name,
+            (double)phase_stats.transactions / div, (double)phase_stats.bytes / div,
+            phase_stats.bus_time_ns / 1000.0 / div, (double)elapsed / div);
+    log_drain(LOG_RECORDS); // 计时之外再格式化驱动日志
+}
+
+// 空闲等待到模拟器拉低INT
+static void wait_for_int(void)
+{
+    while (!tmf8821_sim_int_asserted(&sim))
+    {
+        uint64_t next = tmf8821_sim_next_event_us(&sim);
+        uint64_t now = time_us_64();
+        if (next == UINT64_MAX)
+        {
+            fprintf(stderr, "no interrupt pending, sensor idle\n");
+            exit(1);
+        }
+        host_clock_advance_ns(next > now ? (next - now) * 1000u : 1000u);
+    }
+}
+
+// 改成突发读之前的读法: 先读结果ID, 再从0x38起逐个读27个字节, 每个字节一次事务
+static bool read_result_per_byte(uint8_t *frame)
+{
+    frame[0] = i2c_read_byte(CONFIG_RESULT_REG);
+    if (frame[0] != RESULT_PAGE_ID)
+        return false;
+    for (int j = 0; j < 27; j++)
+        frame[RESULT_ZONE_OFFSET + j] = i2c_read_byte(CONFIG_RESULT_REG + RESULT_ZONE_OFFSET + j);
+    return true;
+}
+
+// 与gpio_callback相同: 先读状态和数据, 再清中断
+static bool service_int(result_frame_t *slot)
+{
+    bool ok = false;
+    uint8_t status = i2c_read_byte(INT_CLEAR_REG);
+    if (slot && (status & INT_HIST))
+        ok = read_hist_packet(slot->data);
+    else if (slot && (status & INT_RESULT))
+        ok = per_byte ? read_result_per_byte(slot->data) : read_result_frame(slot->data);
+    i2c_write_byte(INT_CLEAR_REG, status);
+    return ok;
+}
+
+static void on_hist(const proto_hist_t *hist, void *user)
+{
+    (void)hist;
+    (*(uint32_t *)user)++;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t bus_hz = argc > 1 ? strtoul(argv[1], NULL, 0) : I2C_BUS_HZ;
+    uint32_t frames = argc > 2 ? strtoul(argv[2], NULL, 0) : 100;
+    result_frame_t batch;
+
+    tmf8821_sim_init(&sim, bus_hz);
+    tmf8821_sim_attach(&sim);
+    fprintf(stderr, "bus %u Hz, %u frames\n", bus_hz, frames);
+
+    phase_begin();
+    i2c_write_byte(ENABLE_REG, 0x01);
+    check_device_ready();
+    phase_end("power-on", 1);
+
+    phase_begin();
+    const uint8_t app_version[3] = {TMF882X_IMAGE_APP_MAJOR, TMF882X_IMAGE_APP_MINOR, TMF882X_IMAGE_APP_PATCH};
+    if (tmf8821_boot(tmf882x_image, tmf882x_image_length, app_version) != TMF8821_OK)
+    {
+        fprintf(stderr, "firmware download failed\n");
+        return 1;
+    }
+    phase_end("cold-boot", 1);
+
+    phase_begin();
+    tmf8821_apply_config(tmf8821_find_profile("default"));
+    enable_interrupts();
+    clear_interrupts();
+    start_measurement();
+    phase_end("config", 1);
+
+    const uint8_t cmds[] = {COMMON_CONFIG_REG, WRITE_CONFIG_CMD, MEASURE_CMD};
+    for (size_t i = 0; i < sizeof(cmds); i++)
+    {
+        tmf8821_cmd_stats_t st;
+        tmf8821_get_cmd_stats(cmds[i], &st);
+        fprintf(stderr, "cmd 0x%02X   %u done, %u us latency, %u timeouts, %u errors\n", cmds[i], st.count,
+                st.last_us, st.timeouts, st.errors);
+    }
+
+    for (int mode = 1; mode >= 0; mode--)
+    {
+        uint64_t bus_ns = 0;
+        uint32_t tx = 0, bytes = 0, overrun = sim.frames_overrun;
+        per_byte = mode;
+        for (uint32_t n = 0; n < frames; n++)
+        {
+            wait_for_int();
+            phase_begin();
+            result_frame_t *slot = frame_queue_claim(&queue);
+            if (service_int(slot))
+                frame_queue_commit(&queue);
+            else if (slot)
+                frame_queue_discard(&queue);
+            frame_queue_read(&queue, &batch, 1);
+            i2c_get_stats(&phase_stats);
+            tx += phase_stats.transactions;
+            bytes += phase_stats.bytes;
+            bus_ns += phase_stats.bus_time_ns;
+        }
+        fprintf(stderr, "%-10s %8.1f tx %9.1f bytes %10.1f us bus  (per frame, %u overrun)\n",
+                per_byte ? "per-byte" : "frame", (double)tx / frames, (double)bytes / frames,
+                bus_ns / 1000.0 / frames, sim.frames_overrun - overrun);
+    }
+
+    // 运行中切换到各个配置, 统计切换耗时、写配置的事务数和1秒内的帧数;
+    // 写配置只写出与上一个配置不同的字段, 同一配置再写一次(repeat)应当不走总线
+    for (uint8_t p = 0; p < tmf8821_profile_count; p++)
+    {
+        phase_begin();
+        stop_measurement();
+        i2c_get_stats(&phase_stats);
+        uint32_t apply_tx = phase_stats.transactions;
+        tmf8821_apply_config(&tmf8821_profiles[p]);
+        i2c_get_stats(&phase_stats);
+        uint32_t repeat_tx = phase_stats.transactions;
+        apply_tx = repeat_tx - apply_tx;
+        tmf8821_apply_config(&tmf8821_profiles[p]);
+        i2c_get_stats(&phase_stats);
+        repeat_tx = phase_stats.transactions - repeat_tx;
+        clear_interrupts();
+        start_measurement();
+        i2c_get_stats(&phase_stats);
+        uint64_t switch_us = time_us_64() - phase_start_us;
+        uint32_t before = sim.frames;
+        uint64_t until = time_us_64() + 1000000;
+        while (time_us_64() < until)
+        {
+            wait_for_int();
+            service_int(&batch);
+        }
+        fprintf(stderr, "profile %-9s switch %u tx (apply %u, repeat %u) %6.1f us, %u frames/s\n",
+                tmf8821_profiles[p].name, phase_stats.transactions, apply_tx, repeat_tx, (double)switch_us,
+                sim.frames - before);
+    }
+    tmf8821_shadow_stats_t shadow;
+    tmf8821_get_shadow_stats(&shadow);
+    fprintf(stderr, "shadow     %u sets, %u unchanged, %u writes (%u bytes), %u reads, %u cached, %u skipped\n",
+            shadow.sets, shadow.unchanged, shadow.writes, shadow.bytes, shadow.reads, shadow.reads_cached,
+            shadow.skipped);
+
+    // 直方图模式: 1秒内经队列、编码、解码后完整收到的直方图数
+    stop_measurement();
+    tmf8821_apply_config(tmf8821_find_profile("histogram"));
+    clear_interrupts();
+    start_measurement();
+    static frame_decoder_t decoder;
+    uint32_t hists = 0;
+    uint16_t seq = 0;
+    frame_decoder_init(&decoder, NULL, NULL);
+    decoder.on_hist = on_hist;
+    decoder.user = &hists;
+    uint32_t captures = sim.hist_captures;
+    uint32_t skipped = sim.frames_skipped;
+    phase_begin();
+    while (time_us_64() < phase_start_us + 1000000)
+    {
+        wait_for_int();
+        result_frame_t *slot = frame_queue_claim(&queue);
+        if (service_int(slot))
+            frame_queue_commit(&queue);
+        else if (slot)
+            frame_queue_discard(&queue);
+        while (frame_queue_read(&queue, &batch, 1))
+        {
+            uint8_t packet[PROTO_MAX_PACKET];
+            size_t n = batch.data[0] == HIST_PAGE_ID ? proto_encode_hist(&batch, seq++, packet)
+                                                     : proto_encode_result(&batch, seq++, PROTO_LABEL_UNKNOWN, packet);
+            frame_decoder_feed(&decoder, packet, n);
+        }
+    }
+    captures = sim.hist_captures - captures;
+    phase_end("histogram", captures ? captures : 1);
+    fprintf(stderr, "histogram  %u captured, %u decoded, %u incomplete, %u periods skipped, %u dropped\n", captures,
+            hists, decoder.hist_incomplete, sim.frames_skipped - skipped, queue.dropped);
+
+    // 注入故障: 约3%的传输NACK, 每211次卡死一次总线; 靠重试和总线恢复, 结果编号不应有缺口
+    stop_measurement();
+    tmf8821_apply_config(tmf8821_find_profile("fast"));
+    clear_interrupts();
+    start_measurement();
+    sim.fault_nack_every = 29;
+    sim.fault_stuck_every = 211;
+    uint32_t produced = sim.frames, faults = sim.faults, received = 0;
+    tmf8821_seq_t seq_track;
+    tmf8821_seq_init(&seq_track, tmf8821_find_profile("fast")->period_ms);
+    phase_begin();
+    while (time_us_64() < phase_start_us + 2000000)
+    {
+        wait_for_int();
+        if (service_int(&batch))
+        {
+            received++;
+            tmf8821_seq_update(&seq_track, batch.data[4], time_us_32());
+        }
+    }
+    sim.fault_nack_every = 0;
+    sim.fault_stuck_every = 0;
+    i2c_get_stats(&phase_stats);
+    fprintf(stderr, "faults     %u injected: %u nacks, %u timeouts, %u retries, %u recoveries, %u failed; "
+                    "%u/%u frames, %u lost\n",
+            sim.faults - faults, phase_stats.nacks, phase_stats.timeouts, phase_stats.retries,
+            phase_stats.recoveries, phase_stats.failures, received, sim.frames - produced, seq_track.lost);
+
+    // 待机/恢复: 固件和配置留在传感器里, 只置PON再发MEASURE; 统计唤醒和首帧耗时
+    tmf8821_dev_t *dev = tmf8821_selected();
+    uint64_t resume_bus_ns = 0;
+    uint32_t resume_tx = 0, cycles = 5, standby_ok = 0;
+    for (uint32_t c = 0; c < cycles; c++)
+    {
+        standby_ok += tmf8821_standby() == TMF8821_OK;
+        sleep_ms(100);
+        phase_begin();
+        tmf8821_resume();
+        wait_for_int();
+        tmf8821_power_frame(dev, (uint32_t)sim.int_at_us);
+        service_int(&batch);
+        i2c_get_stats(&phase_stats);
+        resume_tx += phase_stats.transactions;
+        resume_bus_ns += phase_stats.bus_time_ns;
+    }
+    fprintf(stderr, "standby    %u/%u cycles, %.1f tx %.1f us bus per resume; wake %u us, first frame %u us (max %u), "
+                    "profile period %u ms\n",
+            standby_ok, cycles, (double)resume_tx / cycles, resume_bus_ns / 1000.0 / cycles, dev->power.wake_us,
+            dev->power.first_frame_us, dev->power.first_frame_max_us, tmf8821_find_profile("fast")->period_ms);
+
+    // MCU单独复位: 传感器仍在测量, 应跳过下载
+    phase_begin();
+    tmf8821_boot(tmf882x_image, tmf882x_image_length, app_version);
+    phase_end("warm-boot", 1);
+
+    tmf8821_boot_stats_t boot;
+    tmf8821_get_boot_stats(&boot);
+    fprintf(stderr, "boot: %u cold (%u us), %u warm (%u us)\n", boot.cold_starts, boot.cold_start_us,
+            boot.warm_starts, boot.warm_start_us);
+    return 0;
+}
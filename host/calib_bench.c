@@ -0,0 +1,131 @@
+// 标定存储基准: 4个模拟传感器分在两条总线上, 做一次工厂标定并存进模拟的flash扇区,
+// 重新上电(模拟器掉电丢标定)后从flash载入并写回, 统计标定和写回的耗时与总线事务数,
+// 核对写回的数据, 再验证存的数据损坏或被擦除时不写回、照常以未标定状态测量.
+// 用法: calib_bench [bus_hz]   驱动日志走stdout, 报告走stderr
+
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "tmf8821.h"
+#include "tmf882x_image.h"
+#include "tmf8821_sim.h"
+#include "calib_store.h"
+#include "log.h"
+
+#define SENSORS 4
+#define FLASH_SECTOR 4096
+#define PIN_EN_BASE 10
+#define PIN_INT_BASE 20
+
+static tmf8821_sim_t sims[SENSORS];
+static tmf8821_sim_bus_t buses[2];
+static tmf8821_dev_t devs[SENSORS];
+static sensor_array_t array;
+static calib_store_t store;
+static uint8_t flash[FLASH_SECTOR]; // 模拟flash的最后一个扇区
+
+// 重新上电: 模拟器回到上电状态(标定丢失), 启动并写好测量配置
+static int boot(uint32_t bus_hz, const tmf8821_config_t *profile)
+{
+    const uint8_t app_version[3] = {TMF882X_IMAGE_APP_MAJOR, TMF882X_IMAGE_APP_MINOR, TMF882X_IMAGE_APP_PATCH};
+    for (uint8_t b = 0; b < 2; b++)
+        tmf8821_sim_bus_init(&buses[b], bus_hz);
+    for (uint8_t i = 0; i < SENSORS; i++)
+    {
+        tmf8821_sim_init(&sims[i], bus_hz);
+        tmf8821_sim_bus_add(&buses[i % 2], &sims[i], PIN_EN_BASE + i);
+        memset(&devs[i], 0, sizeof(devs[i]));
+        devs[i].bus = &buses[i % 2].transport;
+        devs[i].bus_hz = bus_hz;
+        devs[i].addr = I2C_ADDRESS + 1 + i;
+        devs[i].pin_en = PIN_EN_BASE + i;
+        devs[i].pin_int = PIN_INT_BASE + i;
+    }
+    sensor_array_init(&array, devs, SENSORS);
+    int ready = sensor_array_bringup(&array, tmf882x_image, tmf882x_image_length, app_version);
+    sensor_array_configure(&array, profile);
+    return ready;
+}
+
+// 开始测量, 取第1个传感器的第一帧, 返回第1区的距离(mm)
+static uint16_t first_distance(const tmf8821_config_t *profile)
+{
+    tmf8821_frame_t frame;
+    sensor_array_start(&array, profile->period_ms);
+    while (!tmf8821_sim_int_asserted(&sims[0]))
+        host_clock_advance_ns(100000);
+    tmf8821_select(&devs[0]);
+    uint8_t status = i2c_read_byte(INT_CLEAR_REG);
+    bool ok = read_result_frame((uint8_t *)&frame);
+    i2c_write_byte(INT_CLEAR_REG, status);
+    sensor_array_stop(&array);
+    return ok ? frame.objects[0][0].distance_mm : 0;
+}
+
+// 模拟器里的标定和当初标定出来的一致
+static int verify(void)
+{
+    int matched = 0;
+    for (uint8_t i = 0; i < SENSORS; i++)
+        for (uint8_t k = 0; k < store.count; k++)
+            if (store.entries[k].addr == sims[i].addr && sims[i].calibrated &&
+                memcmp(store.entries[k].data, sims[i].calib, CALIB_DATA_SIZE) == 0)
+                matched++;
+    return matched;
+}
+
+// 从flash载入并写回, 报告结果
+static void restore(const char *name, uint32_t bus_hz, const tmf8821_config_t *profile)
+{
+    i2c_stats_t stats;
+    boot(bus_hz, profile);
+    i2c_reset_stats();
+    uint64_t start = time_us_64();
+    bool loaded = calib_store_load(&store, flash, sizeof(flash));
+    int restored = loaded ? calib_store_restore(&store, &array, profile->spad_map_id) : 0;
+    uint64_t took = time_us_64() - start;
+    i2c_get_stats(&stats);
+    fprintf(stderr, "%-9s %s, %d restored (%d verified) in %6.2f ms, %3u transactions, %5u bytes, zone 1 %u mm\n",
+            name, loaded ? "loaded" : "REJECTED", restored, loaded ? verify() : 0, took / 1000.0,
+            stats.transactions, stats.bytes, first_distance(profile));
+    log_drain(LOG_RECORDS);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t bus_hz = argc > 1 ? strtoul(argv[1], NULL, 0) : I2C_BUS_HZ;
+    const tmf8821_config_t *profile = tmf8821_find_profile("default");
+    uint8_t blob[CALIB_STORE_MAX];
+    i2c_stats_t stats;
+
+    fprintf(stderr, "bus %u Hz, %u sensors, profile %s\n", bus_hz, SENSORS, profile->name);
+    int ready = boot(bus_hz, profile);
+    uint16_t raw = first_distance(profile);
+
+    i2c_reset_stats();
+    uint64_t start = time_us_64();
+    int captured = calib_store_capture(&store, &array, profile->spad_map_id);
+    uint64_t took = time_us_64() - start;
+    i2c_get_stats(&stats);
+    size_t len = calib_store_save(&store, blob);
+    memset(flash, 0xFF, sizeof(flash)); // 先擦后写
+    memcpy(flash, blob, len);
+    fprintf(stderr, "capture   %d of %d ready calibrated in %6.1f ms, %3u transactions, %u byte record, "
+                    "zone 1 %u mm uncalibrated, %u mm calibrated\n",
+            captured, ready, took / 1000.0, stats.transactions, (unsigned)len, raw, first_distance(profile));
+    log_drain(LOG_RECORDS);
+
+    restore("restore", bus_hz, profile);
+    // 标定时的SPAD图换了就不能写回
+    const tmf8821_config_t *other = NULL;
+    for (uint8_t p = 0; p < tmf8821_profile_count && !other; p++)
+        if (tmf8821_profiles[p].spad_map_id != profile->spad_map_id)
+            other = &tmf8821_profiles[p];
+    if (other)
+        restore("other map", bus_hz, other);
+    flash[len / 2] ^= 0x01;
+    restore("corrupt", bus_hz, profile);
+    memset(flash, 0xFF, sizeof(flash));
+    restore("erased", bus_hz, profile);
+    return 0;
+}
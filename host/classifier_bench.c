@@ -0,0 +1,350 @@
+// 分类器基准: 用录下的数据口二进制流(已知液体)标定分类表, 再在另一半数据上
+// 比较原有单区逐值比较、默认表和标定表的准确率, 并测每帧耗时.
+// 用法: classifier_bench [-o table.bin] [label:capture.bin ...]   label为sports/water/cola
+// 不给录像时用带噪声的合成录像(同样经过编码和解码).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "classifier.h"
+#include "frame_decoder.h"
+
+#define RECORD_BYTES (RESULT_ZONES * 3)
+#define MAX_RECORDINGS 16
+#define SYNTH_FRAMES 2000
+#define TIMING_ROUNDS 200
+
+typedef struct
+{
+    uint8_t label;
+    const char *name;
+    uint32_t count;
+    uint32_t cap;
+    uint8_t (*records)[RECORD_BYTES];
+} recording_t;
+
+static recording_t recordings[MAX_RECORDINGS];
+static int recording_count;
+static const char *label_names[] = {"unknown", "sports", "water", "cola"};
+#define LABELS 4
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void on_frame(const proto_result_t *result, void *user)
+{
+    recording_t *r = user;
+    if (r->count == r->cap)
+    {
+        r->cap = r->cap ? r->cap * 2 : 1024;
+        r->records = realloc(r->records, r->cap * sizeof(*r->records));
+    }
+    uint8_t *rec = r->records[r->count++];
+    for (int z = 0; z < RESULT_ZONES; z++)
+    {
+        rec[z * 3] = result->confidence[z];
+        rec[z * 3 + 1] = result->distance_mm[z] & 0xFF;
+        rec[z * 3 + 2] = result->distance_mm[z] >> 8;
+    }
+}
+
+static recording_t *add_recording(uint8_t label, const char *name, const uint8_t *stream, size_t len)
+{
+    if (recording_count == MAX_RECORDINGS)
+        return NULL;
+    recording_t *r = &recordings[recording_count++];
+    frame_decoder_t dec;
+    r->label = label;
+    r->name = name;
+    frame_decoder_init(&dec, on_frame, r);
+    frame_decoder_feed(&dec, stream, len);
+    if (dec.crc_errors || dec.seq_gaps || dec.results_lost)
+        fprintf(stderr, "%s: %u crc errors, %u seq gaps, %u results lost\n", name, dec.crc_errors, dec.seq_gaps,
+                dec.results_lost);
+    return r;
+}
+
+static uint32_t lcg_state = 12345;
+static int32_t noise(int32_t range)
+{
+    int32_t sum = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        lcg_state = lcg_state * 1103515245u + 12345u;
+        sum += (int32_t)((lcg_state >> 16) % (2 * range + 1)) - range;
+    }
+    return sum / 2;
+}
+
+// 合成录像: 杯底距离加上与模拟器相同的各区偏差, 约±1.5 mm噪声, 10%的区没有目标
+static void synth_recording(uint8_t label, uint32_t center_q4)
+{
+    size_t cap = (size_t)SYNTH_FRAMES * PROTO_MAX_PACKET, len = 0;
+    uint8_t *stream = malloc(cap);
+    result_frame_t frame;
+    for (uint32_t n = 0; n < SYNTH_FRAMES; n++)
+    {
+        memset(&frame, 0, sizeof(frame));
+        frame.data[0] = RESULT_PAGE_ID;
+        frame.data[0x04] = (uint8_t)n;
+        for (int z = 0; z < RESULT_ZONES; z++)
+        {
+            uint8_t *rec = &frame.data[RESULT_ZONE_OFFSET + z * 3];
+            lcg_state = lcg_state * 1103515245u + 12345u;
+            if ((lcg_state >> 16) % 10 == 0)
+                continue;
+            uint32_t mm = (center_q4 + z * 3 * 16 + noise(24) + 8) / 16;
+            rec[0] = 60 + (lcg_state >> 8) % 196;
+            rec[1] = mm & 0xFF;
+            rec[2] = mm >> 8;
+        }
+        len += proto_encode_result(&frame, (uint16_t)n, PROTO_LABEL_UNKNOWN, stream + len);
+    }
+    add_recording(label, label_names[label], stream, len);
+    free(stream);
+}
+
+static bool load_file(const char *arg)
+{
+    const char *colon = strchr(arg, ':');
+    uint8_t label = 0;
+    for (uint8_t i = 1; colon && i < LABELS; i++)
+        if ((size_t)(colon - arg) == strlen(label_names[i]) && !strncmp(arg, label_names[i], colon - arg))
+            label = i;
+    FILE *f = colon ? fopen(colon + 1, "rb") : NULL;
+    if (!label || !f)
+    {
+        fprintf(stderr, "bad recording %s\n", arg);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *stream = malloc(len);
+    bool ok = fread(stream, 1, len, f) == (size_t)len && add_recording(label, colon + 1, stream, len);
+    fclose(f);
+    free(stream);
+    return ok;
+}
+
+// 原有判断: 只看第0区, 逐值比较
+static uint8_t legacy_label(const uint8_t *rec)
+{
+    uint8_t dl = rec[1], dm = rec[2];
+    if (dm != 0)
+        return PROTO_LABEL_UNKNOWN;
+    if (dl == 0x52 || dl == 0x53)
+        return PROTO_LABEL_SPORTS_DRINK;
+    if (dl == 0x55)
+        return PROTO_LABEL_WATER;
+    if (dl == 0x57 || dl == 0x58)
+        return PROTO_LABEL_COLA;
+    return PROTO_LABEL_UNKNOWN;
+}
+
+// 前一半数据标定: 各区相对第0区的偏差, 各类的平均距离, 类间取中点为边界
+static void calibrate(classifier_table_t *t)
+{
+    double offset[RESULT_ZONES] = {0};
+    memset(t, 0, sizeof(*t));
+    t->min_confidence = 32;
+    t->zone_mask = (1u << RESULT_ZONES) - 1;
+
+    for (int i = 0; i < recording_count; i++)
+    {
+        recording_t *r = &recordings[i];
+        double sum[RESULT_ZONES] = {0};
+        uint32_t n[RESULT_ZONES] = {0};
+        for (uint32_t f = 0; f < r->count / 2; f++)
+            for (int z = 0; z < RESULT_ZONES; z++)
+            {
+                const uint8_t *rec = &r->records[f][z * 3];
+                if (rec[0] >= t->min_confidence)
+                {
+                    sum[z] += rec[1] | (rec[2] << 8);
+                    n[z]++;
+                }
+            }
+        for (int z = 0; z < RESULT_ZONES; z++)
+            if (n[z] && n[0])
+                offset[z] += (sum[z] / n[z] - sum[0] / n[0]) / recording_count;
+    }
+    for (int z = 0; z < RESULT_ZONES; z++)
+        t->zone_offset_q4[z] = (int16_t)(offset[z] * 16 + (offset[z] < 0 ? -0.5 : 0.5));
+
+    double center[LABELS] = {0};
+    uint32_t frames[LABELS] = {0};
+    classifier_t c;
+    classifier_result_t out;
+    for (int i = 0; i < recording_count; i++)
+    {
+        recording_t *r = &recordings[i];
+        classifier_init(&c, t);
+        for (uint32_t f = 0; f < r->count / 2; f++)
+        {
+            classifier_update(&c, (const tmf8821_object_t *)r->records[f], &out);
+            if (c.frames == CLASSIFIER_WINDOW)
+            {
+                center[r->label] += out.distance_q4;
+                frames[r->label]++;
+            }
+        }
+    }
+
+    uint8_t order[LABELS];
+    int n = 0;
+    for (uint8_t l = 1; l < LABELS; l++)
+        if (frames[l])
+        {
+            center[l] /= frames[l];
+            int k = n++;
+            while (k > 0 && center[order[k - 1]] > center[l])
+            {
+                order[k] = order[k - 1];
+                k--;
+            }
+            order[k] = l;
+        }
+    for (int k = 0; k < n; k++)
+    {
+        double lo = k > 0 ? (center[order[k - 1]] + center[order[k]]) / 2 : 0;
+        double hi = k < n - 1 ? (center[order[k]] + center[order[k + 1]]) / 2 : 0;
+        if (k == 0)
+            lo = n > 1 ? 2 * center[order[0]] - hi : center[order[0]] - 32;
+        if (k == n - 1)
+            hi = n > 1 ? 2 * center[order[k]] - lo : center[order[k]] + 32;
+        t->classes[k].label = order[k];
+        t->classes[k].min_q4 = (uint16_t)(lo + 0.5);
+        t->classes[k].max_q4 = (uint16_t)(hi + 0.5);
+    }
+    t->count = n;
+}
+
+// 后一半数据上的准确率, confusion可为NULL
+static double evaluate(const classifier_table_t *t, uint32_t confusion[LABELS][LABELS])
+{
+    uint32_t correct = 0, total = 0;
+    classifier_t c;
+    classifier_result_t out;
+    for (int i = 0; i < recording_count; i++)
+    {
+        recording_t *r = &recordings[i];
+        if (t)
+            classifier_init(&c, t);
+        for (uint32_t f = r->count / 2; f < r->count; f++)
+        {
+            uint8_t label;
+            if (t)
+            {
+                classifier_update(&c, (const tmf8821_object_t *)r->records[f], &out);
+                label = out.label;
+            }
+            else
+                label = legacy_label(r->records[f]);
+            correct += label == r->label;
+            total++;
+            if (confusion)
+                confusion[r->label][label]++;
+        }
+    }
+    return total ? 100.0 * correct / total : 0;
+}
+
+static double time_per_frame(const classifier_table_t *t, const uint8_t (*records)[RECORD_BYTES], uint32_t count)
+{
+    classifier_t c;
+    classifier_result_t out;
+    uint32_t sink = 0;
+    if (count == 0)
+        return 0;
+    classifier_init(&c, t);
+    double t0 = now_s();
+    for (int round = 0; round < TIMING_ROUNDS; round++)
+        for (uint32_t f = 0; f < count; f++)
+        {
+            classifier_update(&c, (const tmf8821_object_t *)records[f], &out);
+            sink += out.label;
+        }
+    double dt = now_s() - t0;
+    return sink == UINT32_MAX ? 0 : dt * 1e9 / ((double)TIMING_ROUNDS * count);
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            out_path = argv[++i];
+        else if (!load_file(argv[i]))
+            return 1;
+    }
+    if (recording_count == 0)
+    {
+        synth_recording(PROTO_LABEL_SPORTS_DRINK, 0x52 * 16 + 8);
+        synth_recording(PROTO_LABEL_WATER, 0x55 * 16);
+        synth_recording(PROTO_LABEL_COLA, 0x57 * 16 + 8);
+    }
+    for (int i = 0; i < recording_count; i++)
+        printf("recording %-8s %-20s %u frames\n", label_names[recordings[i].label], recordings[i].name,
+               recordings[i].count);
+
+    classifier_table_t table;
+    calibrate(&table);
+    printf("calibrated: zone offsets (1/16 mm)");
+    for (int z = 0; z < RESULT_ZONES; z++)
+        printf(" %d", table.zone_offset_q4[z]);
+    printf("\n");
+    for (int k = 0; k < table.count; k++)
+        printf("  %-8s %7.2f .. %7.2f mm\n", label_names[table.classes[k].label], table.classes[k].min_q4 / 16.0,
+               table.classes[k].max_q4 / 16.0);
+
+    uint32_t confusion[LABELS][LABELS] = {{0}};
+    printf("accuracy (second half of each recording):\n");
+    printf("  %-10s %6.1f%%\n", "legacy", evaluate(NULL, NULL));
+    printf("  %-10s %6.1f%%\n", "default", evaluate(&classifier_default_table, NULL));
+    printf("  %-10s %6.1f%%\n", "calibrated", evaluate(&table, confusion));
+    printf("confusion (row: truth, column: output)\n%-8s", "");
+    for (int l = 0; l < LABELS; l++)
+        printf(" %8s", label_names[l]);
+    printf("\n");
+    for (int t = 1; t < LABELS; t++)
+    {
+        printf("%-8s", label_names[t]);
+        for (int l = 0; l < LABELS; l++)
+            printf(" %8u", confusion[t][l]);
+        printf("\n");
+    }
+
+    // 每帧耗时应与内容无关: 有效数据和全空帧各测一次
+    static const uint8_t empty[1][RECORD_BYTES];
+    recording_t *r = &recordings[0];
+    printf("update: %.1f ns/frame (recorded), %.1f ns/frame (empty frames)\n",
+           time_per_frame(&table, (const uint8_t(*)[RECORD_BYTES])r->records, r->count),
+           time_per_frame(&table, empty, 1));
+
+    if (out_path)
+    {
+        uint8_t blob[CLASSIFIER_BLOB_MAX];
+        size_t len = classifier_save(&table, blob);
+        FILE *f = fopen(out_path, "wb");
+        if (!f || fwrite(blob, 1, len, f) != len)
+        {
+            fprintf(stderr, "cannot write %s\n", out_path);
+            return 1;
+        }
+        fclose(f);
+        classifier_table_t check;
+        printf("wrote %zu byte table to %s (%s)\n", len, out_path,
+               classifier_load(&check, blob, len) ? "verified" : "BAD");
+    }
+
+    for (int i = 0; i < recording_count; i++)
+        free(recordings[i].records);
+    return 0;
+}
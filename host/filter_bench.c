@@ -0,0 +1,110 @@
+// 滤波基准: 在带噪声、丢点和离群值的合成帧上比较各滤波模式的误差、分类稳定性、
+// 换杯后的收敛帧数和每帧耗时. 板上的每帧周期数见负载报告(串口按f切换模式).
+// 用法: filter_bench [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "zone_filter.h"
+#include "classifier.h"
+#include "frame_proto.h"
+
+#define SETTLE_MM 1
+
+typedef tmf8821_object_t record_t[RESULT_OBJECTS][RESULT_ZONES]; // 一帧的全部目标, 同tmf8821_frame_t.objects
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t lcg_state = 2024;
+static uint32_t lcg(void)
+{
+    lcg_state = lcg_state * 1103515245u + 12345u;
+    return lcg_state >> 16;
+}
+
+// 前一半是水(85 mm), 后一半换成可乐(87.5 mm); 各区偏差同模拟器
+// 约±1.5 mm噪声, 10%无目标, 3%为±10 mm离群值
+static void make_frames(record_t *records, uint32_t *truth_q4, uint32_t frames)
+{
+    for (uint32_t n = 0; n < frames; n++)
+    {
+        truth_q4[n] = n < frames / 2 ? 0x55 * 16 : 0x57 * 16 + 8;
+        memset(records[n], 0, sizeof(record_t));
+        for (int z = 0; z < RESULT_ZONES; z++)
+        {
+            tmf8821_object_t *rec = &records[n][0][z];
+            uint32_t r = lcg();
+            if (r % 10 == 0)
+                continue;
+            int32_t noise = 0;
+            for (int i = 0; i < 4; i++)
+                noise += (int32_t)(lcg() % 49) - 24;
+            noise /= 2;
+            if (r % 33 == 1)
+                noise += (r & 0x100) ? 160 : -160;
+            uint32_t mm = (truth_q4[n] + z * 3 * 16 + noise + 8) / 16;
+            rec->confidence = 60 + lcg() % 196;
+            rec->distance_mm = mm;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 20000;
+    record_t *records = malloc((size_t)frames * sizeof(record_t));
+    record_t *work = malloc((size_t)frames * sizeof(record_t));
+    uint32_t *truth = malloc(frames * sizeof(*truth));
+    make_frames(records, truth, frames);
+
+    printf("%u frames, water -> cola at frame %u\n", frames, frames / 2);
+    printf("%-8s %9s %10s %9s %9s %10s\n", "filter", "rms mm", "accuracy", "flips", "settle", "ns/frame");
+    for (int mode = 0; mode < ZONE_FILTER_MODES; mode++)
+    {
+        zone_filter_t f;
+        memcpy(work, records, (size_t)frames * sizeof(record_t));
+        zone_filter_init(&f, mode);
+        double t0 = now_s();
+        for (uint32_t n = 0; n < frames; n++)
+            zone_filter_apply(&f, work[n]);
+        double dt = now_s() - t0;
+
+        // 第0区误差(无目标的帧不计), 默认分类表的准确率和输出跳变次数
+        classifier_t c;
+        classifier_result_t out;
+        classifier_init(&c, &classifier_default_table);
+        double err2 = 0;
+        uint32_t valid = 0, correct = 0, flips = 0, settle = 0;
+        uint8_t last = PROTO_LABEL_UNKNOWN;
+        for (uint32_t n = 0; n < frames; n++)
+        {
+            const tmf8821_object_t *obj = work[n][0];
+            double e = obj[0].distance_mm - truth[n] / 16.0;
+            if (records[n][0][0].confidence)
+            {
+                err2 += e * e;
+                valid++;
+            }
+            if (n >= frames / 2 && !settle && fabs(e) <= SETTLE_MM && records[n][0][0].confidence)
+                settle = n - frames / 2 + 1;
+            classifier_update(&c, obj, &out);
+            correct += out.label == (n < frames / 2 ? PROTO_LABEL_WATER : PROTO_LABEL_COLA);
+            flips += n && out.label != last;
+            last = out.label;
+        }
+        printf("%-8s %9.2f %9.1f%% %9u %9u %10.1f\n", zone_filter_names[mode], sqrt(err2 / valid),
+               100.0 * correct / frames, flips, settle, dt * 1e9 / frames);
+    }
+
+    free(records);
+    free(work);
+    free(truth);
+    return 0;
+}
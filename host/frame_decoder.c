@@ -0,0 +1,126 @@
+#include <string.h>
+#include "frame_decoder.h"
+
+void frame_decoder_init(frame_decoder_t *dec, frame_decoder_cb on_frame, void *user)
+{
+    memset(dec, 0, sizeof(*dec));
+    dec->on_frame = on_frame;
+    dec->user = user;
+}
+
+static void decoder_hist(frame_decoder_t *dec, const proto_hist_packet_t *pkt)
+{
+    if (pkt->index == 0)
+    {
+        if (dec->hist_mask)
+            dec->hist_incomplete++;
+        memset(&dec->hist, 0, sizeof(dec->hist));
+        dec->hist.timestamp_us = pkt->timestamp_us;
+        dec->hist.sensor = pkt->sensor;
+        dec->hist_mask = 0;
+    }
+    else if (pkt->sensor != dec->hist.sensor || !(dec->hist_mask & (1u << (pkt->index - 1))))
+        return; // 前面的包丢了, 等下一组
+
+    uint32_t *bins = dec->hist.bins[pkt->index / 3];
+    uint8_t shift = 8 * (pkt->index % 3);
+    for (int b = 0; b < HIST_BINS; b++)
+    {
+        bins[b] |= (uint32_t)pkt->data[b] << shift;
+    }
+    dec->hist_mask |= 1u << pkt->index;
+
+    if (pkt->index == HIST_PACKETS - 1)
+    {
+        dec->hists++;
+        dec->hist_mask = 0;
+        if (dec->on_hist)
+            dec->on_hist(&dec->hist, dec->user);
+    }
+}
+
+static void decoder_packet(frame_decoder_t *dec)
+{
+    uint8_t payload[PROTO_MAX_PACKET];
+    proto_result_t result;
+    proto_hist_packet_t hist;
+    proto_trace_t trace;
+    proto_log_t log;
+    proto_depth_t depth;
+    proto_points_t points;
+
+    size_t n = proto_cobs_decode(dec->buf, dec->len, payload);
+    if (n == 0)
+    {
+        dec->framing_errors++;
+        return;
+    }
+    if (!proto_check(payload, n))
+    {
+        dec->crc_errors++;
+        return;
+    }
+
+    uint16_t seq = payload[1] | (payload[2] << 8);
+    if (dec->has_seq)
+        dec->seq_gaps += (uint16_t)(seq - dec->last_seq - 1);
+    dec->has_seq = true;
+    dec->last_seq = seq;
+
+    if (proto_parse_result(payload, n, &result))
+    {
+        dec->frames++;
+        dec->results_lost += tmf8821_seq_update(&dec->result_seq[result.sensor], result.result_number,
+                                                result.timestamp_us);
+        if (dec->on_frame)
+            dec->on_frame(&result, dec->user);
+    }
+    else if (proto_parse_hist(payload, n, &hist))
+        decoder_hist(dec, &hist);
+    else if (proto_parse_trace(payload, n, &trace))
+    {
+        dec->trace_packets++;
+        if (dec->on_trace)
+            dec->on_trace(&trace, dec->user);
+    }
+    else if (proto_parse_depth(payload, n, &depth))
+    {
+        dec->depth_frames++;
+        if (dec->on_depth)
+            dec->on_depth(&depth, dec->user);
+    }
+    else if (proto_parse_points(payload, n, &points))
+    {
+        dec->point_frames++;
+        if (dec->on_points)
+            dec->on_points(&points, dec->user);
+    }
+    else if (proto_parse_log(payload, n, &log))
+    {
+        dec->log_packets++;
+        if (dec->on_log)
+            dec->on_log(&log, dec->user);
+    }
+    else
+        dec->crc_errors++;
+}
+
+void frame_decoder_feed(frame_decoder_t *dec, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (data[i] == 0x00)
+        {
+            if (dec->overlong)
+                dec->framing_errors++;
+            else if (dec->len > 0)
+                decoder_packet(dec);
+            dec->len = 0;
+            dec->overlong = false;
+        }
+        else if (dec->len < sizeof(dec->buf))
+            dec->buf[dec->len++] = data[i];
+        else
+            dec->overlong = true;
+    }
+}
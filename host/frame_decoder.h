@@ -0,0 +1,56 @@
+#ifndef FRAME_DECODER_H
+#define FRAME_DECODER_H
+
+// 主机端二进制流解码: 按0x00分包, COBS解码, 校验CRC, 跟踪序号,
+// 把一组直方图包拼成完整的原始直方图, 深度图、点云、跟踪包和日志包原样交给回调
+
+#include "frame_proto.h"
+
+typedef struct
+{
+    uint32_t timestamp_us; // 第一包的时间
+    uint8_t sensor;        // 同一时间只拼一个传感器的直方图
+    uint32_t bins[HIST_CHANNELS][HIST_BINS];
+} proto_hist_t;
+
+typedef void (*frame_decoder_cb)(const proto_result_t *result, void *user);
+typedef void (*frame_decoder_hist_cb)(const proto_hist_t *hist, void *user);
+typedef void (*frame_decoder_trace_cb)(const proto_trace_t *trace, void *user);
+typedef void (*frame_decoder_log_cb)(const proto_log_t *log, void *user);
+typedef void (*frame_decoder_depth_cb)(const proto_depth_t *depth, void *user);
+typedef void (*frame_decoder_points_cb)(const proto_points_t *points, void *user);
+
+typedef struct
+{
+    uint8_t buf[PROTO_MAX_PACKET];
+    size_t len;
+    bool overlong;         // 当前包超长, 丢到下一个分隔符
+    bool has_seq;
+    uint16_t last_seq;
+    uint32_t frames;
+    uint32_t crc_errors;   // CRC/长度/类型不对的包
+    uint32_t framing_errors;
+    uint32_t seq_gaps;     // 序号不连续时丢失的包数
+    uint32_t results_lost; // 结果编号跳过的帧(传感器到主机整条链路)
+    tmf8821_seq_t result_seq[16];
+    proto_hist_t hist;
+    uint32_t hist_mask;    // 已收到的直方图包
+    uint32_t hists;        // 完整的直方图
+    uint32_t hist_incomplete;
+    uint32_t trace_packets;
+    uint32_t log_packets;
+    uint32_t depth_frames;
+    uint32_t point_frames;
+    frame_decoder_cb on_frame;
+    frame_decoder_hist_cb on_hist;
+    frame_decoder_trace_cb on_trace;
+    frame_decoder_log_cb on_log;
+    frame_decoder_depth_cb on_depth;
+    frame_decoder_points_cb on_points;
+    void *user;
+} frame_decoder_t;
+
+void frame_decoder_init(frame_decoder_t *dec, frame_decoder_cb on_frame, void *user);
+void frame_decoder_feed(frame_decoder_t *dec, const uint8_t *data, size_t len);
+
+#endif
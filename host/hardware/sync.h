@@ -0,0 +1,11 @@
+#ifndef HOST_HARDWARE_SYNC_H
+#define HOST_HARDWARE_SYNC_H
+
+// 主机构建用的hardware/sync.h替代: 没有中断, 临界区为空
+
+#include <stdint.h>
+
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void restore_interrupts(uint32_t status) { (void)status; }
+
+#endif
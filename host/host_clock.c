@@ -0,0 +1,60 @@
+#include "pico/stdlib.h"
+
+static uint64_t now_ns;
+static uint32_t gpio_levels;
+
+void host_clock_advance_ns(uint64_t ns)
+{
+    now_ns += ns;
+}
+
+uint64_t host_clock_ns(void)
+{
+    return now_ns;
+}
+
+void sleep_ms(uint32_t ms)
+{
+    now_ns += (uint64_t)ms * 1000000u;
+}
+
+void sleep_us(uint64_t us)
+{
+    now_ns += us * 1000u;
+}
+
+void busy_wait_us_32(uint32_t us)
+{
+    now_ns += (uint64_t)us * 1000u;
+}
+
+uint64_t time_us_64(void)
+{
+    return now_ns / 1000u;
+}
+
+uint32_t time_us_32(void)
+{
+    return (uint32_t)(now_ns / 1000u);
+}
+
+void gpio_init(uint gpio)
+{
+    gpio_levels &= ~(1u << gpio);
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+    (void)gpio;
+    (void)out;
+}
+
+void gpio_put(uint gpio, bool value)
+{
+    gpio_levels = (gpio_levels & ~(1u << gpio)) | ((uint32_t)value << gpio);
+}
+
+bool gpio_get(uint gpio)
+{
+    return (gpio_levels >> gpio) & 1;
+}
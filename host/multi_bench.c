@@ -0,0 +1,127 @@
+// 多传感器基准: 1~4个模拟传感器挂在一条或两条总线上, 统计启动(上电、下载、改址)耗时
+// 和测量时的总帧率, 中断服务方式与gpio_callback相同.
+// 按结果编号(和应有帧数)统计丢帧, 并给出INT下降沿到进中断、进中断到读完的最大延迟;
+// 丢帧为0且延迟小于一个周期才算跟得上这个测量周期.
+// 用法: multi_bench [bus_hz] [profile]   驱动日志走stdout, 报告走stderr
+
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "tmf8821.h"
+#include "tmf882x_image.h"
+#include "tmf8821_sim.h"
+#include "sensor_array.h"
+#include "log.h"
+
+#define RUN_US 1000000
+#define PIN_EN_BASE 10
+#define PIN_INT_BASE 20
+
+static tmf8821_sim_t sims[SENSOR_MAX];
+static tmf8821_sim_bus_t buses[2];
+static tmf8821_dev_t devs[SENSOR_MAX];
+static sensor_array_t array;
+
+static void run(uint32_t bus_hz, const tmf8821_config_t *profile, uint8_t count, uint8_t nbuses)
+{
+    const uint8_t app_version[3] = {TMF882X_IMAGE_APP_MAJOR, TMF882X_IMAGE_APP_MINOR, TMF882X_IMAGE_APP_PATCH};
+    uint8_t frame[RESULT_FRAME_SIZE];
+    uint32_t frames[SENSOR_MAX] = {0};
+    tmf8821_seq_t seq[SENSOR_MAX];
+    uint32_t edge_max = 0, latency_max = 0;
+    i2c_stats_t stats;
+
+    for (uint8_t b = 0; b < nbuses; b++)
+        tmf8821_sim_bus_init(&buses[b], bus_hz);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        tmf8821_sim_init(&sims[i], bus_hz);
+        tmf8821_sim_bus_add(&buses[i % nbuses], &sims[i], PIN_EN_BASE + i);
+        memset(&devs[i], 0, sizeof(devs[i]));
+        devs[i].bus = &buses[i % nbuses].transport;
+        devs[i].bus_hz = bus_hz;
+        devs[i].addr = I2C_ADDRESS + 1 + i;
+        devs[i].pin_en = PIN_EN_BASE + i;
+        devs[i].pin_int = PIN_INT_BASE + i;
+    }
+
+    sensor_array_init(&array, devs, count);
+    uint64_t start = time_us_64();
+    int ready = sensor_array_bringup(&array, tmf882x_image, tmf882x_image_length, app_version);
+    uint64_t bringup = time_us_64() - start;
+    sensor_array_configure(&array, profile);
+    sensor_array_start(&array, profile->period_ms);
+    for (uint8_t i = 0; i < count; i++)
+        tmf8821_seq_init(&seq[i], profile->period_ms);
+
+    // 总是先服务序号最小的已拉低INT的传感器, 都没有时空闲到下一个事件
+    i2c_reset_stats();
+    uint64_t until = time_us_64() + RUN_US;
+    while (time_us_64() < until)
+    {
+        int sensor = -1;
+        uint64_t next = UINT64_MAX;
+        for (uint8_t i = 0; i < count && sensor < 0; i++)
+        {
+            if (tmf8821_sim_int_asserted(&sims[i]))
+                sensor = i;
+            else if (tmf8821_sim_next_event_us(&sims[i]) < next)
+                next = tmf8821_sim_next_event_us(&sims[i]);
+        }
+        if (sensor < 0)
+        {
+            uint64_t now = time_us_64();
+            host_clock_advance_ns(next != UINT64_MAX && next > now ? (next - now) * 1000u : 1000u);
+            continue;
+        }
+        uint32_t start = time_us_32();
+        uint32_t edge = start - (uint32_t)sims[sensor].int_at_us; // 从帧按周期拉低INT起, 等别的传感器的时间
+        tmf8821_select(&devs[sensor]);
+        uint8_t status = i2c_read_byte(INT_CLEAR_REG);
+        if ((status & INT_RESULT) && read_result_frame(frame))
+        {
+            frames[sensor]++;
+            tmf8821_seq_update(&seq[sensor], frame[4], start);
+            uint32_t latency = time_us_32() - start;
+            latency_max = latency > latency_max ? latency : latency_max;
+            edge_max = edge > edge_max ? edge : edge_max;
+        }
+        i2c_write_byte(INT_CLEAR_REG, status);
+    }
+    i2c_get_stats(&stats);
+    sensor_array_stop(&array);
+
+    uint32_t total = 0, overrun = 0, lost = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        total += frames[i];
+        overrun += sims[i].frames_overrun;
+        // 饿死的传感器没有编号缺口可看, 按运行时间应有的帧数补上
+        uint32_t expected = RUN_US / (profile->period_ms * 1000u);
+        uint32_t missing = expected > frames[i] + 1 ? expected - frames[i] : 0;
+        lost += seq[i].lost > missing ? seq[i].lost : missing;
+    }
+    bool keeping_up = lost == 0 && edge_max + latency_max < profile->period_ms * 1000u;
+    fprintf(stderr, "%u sensor(s) on %u bus(es): %d ready, bring-up %8.1f ms, %5u frames/s, %3u overrun, "
+                    "%4u lost, edge %6u us, read %6u us, bus %5.1f%% %s\n",
+            count, nbuses, ready, bringup / 1000.0, total, overrun, lost, edge_max, latency_max,
+            stats.bus_time_ns / 10.0 / RUN_US, keeping_up ? "ok" : "FALLING BEHIND");
+    log_drain(LOG_RECORDS);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t bus_hz = argc > 1 ? strtoul(argv[1], NULL, 0) : I2C_BUS_HZ;
+    const tmf8821_config_t *profile = tmf8821_find_profile(argc > 2 ? argv[2] : "default");
+    if (!profile)
+    {
+        fprintf(stderr, "unknown profile\n");
+        return 1;
+    }
+
+    fprintf(stderr, "bus %u Hz, profile %s (%u ms)\n", bus_hz, profile->name, profile->period_ms);
+    for (uint8_t nbuses = 1; nbuses <= 2; nbuses++)
+        for (uint8_t count = nbuses; count <= SENSOR_MAX; count++)
+            run(bus_hz, profile, count, nbuses);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+// 主机构建用的pico/stdlib.h替代: 只提供驱动用到的接口, 时间为虚拟时钟
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef unsigned int uint;
+
+void sleep_ms(uint32_t ms);
+void sleep_us(uint64_t us);
+void busy_wait_us_32(uint32_t us);
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+
+static inline void tight_loop_contents(void) {}
+static inline uint get_core_num(void) { return 0; } // 主机上只有一个"核"
+
+// GPIO: 只记电平, 模拟器据此判断传感器的使能脚
+#define GPIO_IN 0
+#define GPIO_OUT 1
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+
+// 虚拟时钟推进(纳秒), 供模拟器按总线时间计时
+void host_clock_advance_ns(uint64_t ns);
+uint64_t host_clock_ns(void);
+
+#endif
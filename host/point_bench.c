@@ -0,0 +1,128 @@
+// 点云基准: 在每个SPAD图的合成深度图上(各区两目标, 约15%无目标)检查定点转换的最大误差,
+// 统计每帧耗时、点数和点云包与深度图包的字节数, 点云包经解码器解回应与原点一致.
+// 板上的每帧周期数见负载报告(串口按p切换点云输出).
+// 用法: point_bench [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "point_cloud.h"
+#include "frame_proto.h"
+#include "frame_decoder.h"
+
+#define MAX_MM 4000
+
+static point_t decoded[POINT_CLOUD_MAX];
+static uint8_t decoded_count;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t lcg_state = 2024;
+static uint32_t lcg(void)
+{
+    lcg_state = lcg_state * 1103515245u + 12345u;
+    return lcg_state >> 16;
+}
+
+static void make_frames(depth_frame_t *frames, uint32_t count, const tmf8821_spad_map_t *map)
+{
+    for (uint32_t n = 0; n < count; n++)
+    {
+        depth_frame_t *f = &frames[n];
+        memset(f, 0, sizeof(*f));
+        f->number = n;
+        f->spad_map_id = map->id;
+        f->rows = map->rows;
+        f->cols = map->cols;
+        for (int o = 0; o < RESULT_OBJECTS; o++)
+            for (int z = 0; z < map->rows * map->cols; z++)
+            {
+                if (lcg() % 100 < 15)
+                    continue;
+                f->zones[o][z].confidence = 1 + lcg() % 255;
+                f->zones[o][z].distance_mm = 20 + lcg() % MAX_MM;
+            }
+    }
+}
+
+static void on_points(const proto_points_t *pts, void *user)
+{
+    (void)user;
+    decoded_count = pts->count;
+    memcpy(decoded, pts->points, pts->count * sizeof(point_t));
+}
+
+// 点按区号、同区第一目标在前排列, 按同样的顺序找回原距离; 误差为点到原点的距离与测得距离之差,
+// 方向表的长度偏离1的部分也算进去
+static double check(const depth_frame_t *frames, uint32_t count, point_t *points)
+{
+    const point_dir_t *dirs = point_cloud_dirs(frames[0].spad_map_id);
+    double worst = 0;
+    for (uint32_t n = 0; n < count; n++)
+    {
+        const depth_frame_t *f = &frames[n];
+        uint8_t k = point_cloud_convert(f, points), i = 0;
+        for (int z = 0; z < f->rows * f->cols; z++)
+            for (int o = 0; o < RESULT_OBJECTS; o++)
+            {
+                if (!f->zones[o][z].confidence)
+                    continue;
+                if (i >= k || points[i].zone != z)
+                    return INFINITY;
+                const point_t *p = &points[i++];
+                const point_dir_t *d = &dirs[z];
+                double len = sqrt((double)d->x * d->x + (double)d->y * d->y + (double)d->z * d->z) / POINT_DIR_ONE;
+                double r = sqrt((double)p->x * p->x + (double)p->y * p->y + (double)p->z * p->z);
+                double mm = f->zones[o][z].distance_mm;
+                double e = fabs(r - mm) + fabs(len - 1) * mm;
+                worst = e > worst ? e : worst;
+            }
+    }
+    return worst;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 20000;
+    depth_frame_t *work = malloc((size_t)frames * sizeof(*work));
+    point_t points[POINT_CLOUD_MAX];
+    uint8_t packet[PROTO_MAX_PACKET];
+
+    printf("%u frames per map, distances up to %u mm\n", frames, MAX_MM);
+    printf("%-10s %5s %10s %8s %10s %12s %12s %9s\n", "map", "zones", "points", "max mm", "ns/frame", "points bytes",
+           "depth bytes", "decoded");
+    for (uint8_t m = 0; m < tmf8821_spad_map_count; m++)
+    {
+        const tmf8821_spad_map_t *map = &tmf8821_spad_maps[m];
+        make_frames(work, frames, map);
+
+        uint32_t total = 0;
+        double t0 = now_s();
+        for (uint32_t n = 0; n < frames; n++)
+            total += point_cloud_convert(&work[n], points);
+        double dt = now_s() - t0;
+
+        double worst = check(work, frames, points);
+        uint8_t k = point_cloud_convert(&work[0], points);
+        size_t point_bytes = proto_encode_points(&work[0], points, k, 0, 0, packet);
+        frame_decoder_t dec;
+        frame_decoder_init(&dec, NULL, NULL);
+        dec.on_points = on_points;
+        decoded_count = 0;
+        frame_decoder_feed(&dec, packet, point_bytes);
+        bool same = dec.point_frames == 1 && decoded_count == k && !memcmp(decoded, points, k * sizeof(point_t));
+        size_t depth_bytes = proto_encode_depth(&work[0], 0, 0, packet);
+        printf("%-10s %5u %10.1f %8.2f %10.1f %12zu %12zu %9s\n", map->name, map->rows * map->cols,
+               (double)total / frames, worst, dt * 1e9 / frames, point_bytes, depth_bytes, same ? "ok" : "MISMATCH");
+    }
+
+    free(work);
+    return 0;
+}
@@ -0,0 +1,118 @@
+// 输出协议基准: 比较原有文本输出与二进制包的每帧字节数、编解码速度和链路上限帧率.
+// 用法: proto_bench [frames] [link_bytes_per_s]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "frame_proto.h"
+#include "frame_decoder.h"
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// 与模拟器相同的结果页内容
+static void make_frame(result_frame_t *frame, uint32_t n)
+{
+    memset(frame, 0, sizeof(*frame));
+    frame->timestamp_us = n * 10000u;
+    frame->data[0x00] = RESULT_PAGE_ID;
+    frame->data[0x04] = (uint8_t)n;
+    frame->data[0x05] = 25;
+    frame->data[0x06] = 9;
+    for (int zone = 0; zone < RESULT_ZONES; zone++)
+    {
+        uint16_t dist = 0x55 + zone * 3 + (n % 3) - 1;
+        frame->data[RESULT_ZONE_OFFSET + zone * 3] = 0xC8;
+        frame->data[RESULT_ZONE_OFFSET + zone * 3 + 1] = dist & 0xFF;
+        frame->data[RESULT_ZONE_OFFSET + zone * 3 + 2] = dist >> 8;
+    }
+}
+
+// 原有printf输出: 只有第0区距离和分类文字
+static size_t text_legacy(const result_frame_t *frame, char *out)
+{
+    uint8_t dl = frame->data[RESULT_ZONE_OFFSET + 1];
+    uint8_t dm = frame->data[RESULT_ZONE_OFFSET + 2];
+    int n = sprintf(out, "value:\n 0x%02X%02X\n", dm, dl);
+    if (dm == 0 && dl == 0x55)
+        n += sprintf(out + n, "可能是水\n");
+    return n;
+}
+
+// 同样的十六进制文本风格, 但带上二进制包里的全部信息
+static size_t text_full(const result_frame_t *frame, uint16_t seq, char *out)
+{
+    int n = sprintf(out, "frame %u %lu %u %u %u:", seq, (unsigned long)frame->timestamp_us, frame->data[0x04],
+                    frame->data[0x05], frame->data[0x06]);
+    for (int i = 0; i < PROTO_RECORDS; i++)
+    {
+        const uint8_t *rec = &frame->data[RESULT_ZONE_OFFSET + i * 3];
+        n += sprintf(out + n, " %02X:0x%02X%02X", rec[0], rec[2], rec[1]);
+    }
+    n += sprintf(out + n, "\n");
+    return n;
+}
+
+static void on_frame(const proto_result_t *result, void *user)
+{
+    (*(uint32_t *)user) += result->distance_mm[0];
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 200000;
+    double link = argc > 2 ? strtod(argv[2], NULL) : 1000000.0;
+    result_frame_t frame;
+    char text[1024];
+    uint8_t *stream = malloc((size_t)frames * PROTO_MAX_PACKET);
+    size_t legacy_bytes = 0, full_bytes = 0, bin_bytes = 0;
+
+    double t0 = now_s();
+    for (uint32_t n = 0; n < frames; n++)
+    {
+        make_frame(&frame, n);
+        legacy_bytes += text_legacy(&frame, text);
+    }
+    double t_legacy = now_s() - t0;
+
+    t0 = now_s();
+    for (uint32_t n = 0; n < frames; n++)
+    {
+        make_frame(&frame, n);
+        full_bytes += text_full(&frame, (uint16_t)n, text);
+    }
+    double t_full = now_s() - t0;
+
+    t0 = now_s();
+    for (uint32_t n = 0; n < frames; n++)
+    {
+        make_frame(&frame, n);
+        bin_bytes += proto_encode_result(&frame, (uint16_t)n, PROTO_LABEL_WATER, stream + bin_bytes);
+    }
+    double t_bin = now_s() - t0;
+
+    frame_decoder_t dec;
+    uint32_t checksum = 0;
+    frame_decoder_init(&dec, on_frame, &checksum);
+    t0 = now_s();
+    frame_decoder_feed(&dec, stream, bin_bytes);
+    double t_dec = now_s() - t0;
+
+    printf("%u frames, link %.0f bytes/s\n", frames, link);
+    printf("%-12s %8s %14s %14s\n", "format", "B/frame", "encode fr/s", "link fr/s");
+    printf("%-12s %8.1f %14.0f %14.0f\n", "text-legacy", (double)legacy_bytes / frames, frames / t_legacy,
+           link * frames / legacy_bytes);
+    printf("%-12s %8.1f %14.0f %14.0f\n", "text-full", (double)full_bytes / frames, frames / t_full,
+           link * frames / full_bytes);
+    printf("%-12s %8.1f %14.0f %14.0f\n", "binary", (double)bin_bytes / frames, frames / t_bin,
+           link * frames / bin_bytes);
+    printf("decode: %.0f frames/s, %u ok, %u crc errors, %u framing errors, %u seq gaps, %u results lost\n",
+           frames / t_dec, dec.frames, dec.crc_errors, dec.framing_errors, dec.seq_gaps, dec.results_lost);
+    free(stream);
+    return dec.frames == frames && dec.seq_gaps == 0 && dec.results_lost == 0 ? 0 : 1;
+}
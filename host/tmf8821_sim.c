@@ -0,0 +1,568 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "tmf8821_sim.h"
+#include "tmf882x_image.h"
+
+// 引导程序命令与状态
+#define BL_CMD_RAMREMAP_RESET 0x11
+#define BL_CMD_DOWNLOAD_INIT 0x14
+#define BL_CMD_W_RAM 0x41
+#define BL_CMD_SET_ADDR 0x43
+#define BL_STAT_READY 0x00
+#define BL_STAT_ERR_SIZE 0x01
+#define BL_STAT_ERR_CSUM 0x02
+#define BL_STAT_ERR_APP 0x04
+#define BL_STAT_ERR_RANGE 0x07
+
+// 应用命令
+#define APP_CMD_MEASURE 0x10
+#define APP_CMD_STOP 0x11
+#define APP_CMD_WRITE_CONFIG 0x15
+#define APP_CMD_LOAD_CONFIG_COMMON 0x16
+#define APP_CMD_LOAD_CONFIG_CALIB 0x19
+#define APP_CMD_FACTORY_CALIB 0x20
+#define APP_CMD_I2C_ADDRESS 0x21
+#define APP_STAT_OK 0x00
+#define APP_STAT_ACCEPTED 0x01
+
+// 模拟延时(µs)
+#define SIM_CPU_INIT_US 1000
+#define SIM_BL_CMD_US 50
+#define SIM_APP_BOOT_US 2000
+#define SIM_APP_CMD_US 300
+#define SIM_HIST_PACKET_US 20
+#define SIM_CALIB_US 200000
+#define SIM_UNCALIBRATED_MM 15 // 没有标定时串扰带来的距离偏差
+
+#define RESULT_PAGE_ID 0x10
+#define CFG_HIST_DUMP 0x19 // config[]下标, 对应寄存器0x39
+#define CFG_I2C_ADDRESS 0x1B
+#define CFG_SPAD_MAP 0x14
+#define SPAD_MAP_4X4 7 // 分时复用, 每次子采集8区
+#define SPAD_MAP_3X6 10 // 分时复用, 每次子采集9区
+#define RESULT_PAGE_END 0x9C
+#define HIST_PAGE_ID 0x81
+#define HIST_PACKET_DATA 128
+#define HIST_PACKETS 30
+#define HIST_IDLE 0xFF
+#define INT_RESULT 0x02
+#define INT_HIST 0x04
+
+static void sim_step(tmf8821_sim_t *sim);
+
+// 按总线时钟推进虚拟时间: 起始位 + 地址字节 + 数据字节(各含ACK位) [+ 停止位]
+static void sim_wire(uint32_t bus_hz, size_t len, bool nostop)
+{
+    uint32_t bits = 1 + 9 * (1 + len) + (nostop ? 0 : 1);
+    host_clock_advance_ns((uint64_t)bits * 1000000000u / bus_hz);
+}
+
+static uint16_t sim_period_ms(tmf8821_sim_t *sim)
+{
+    uint16_t period = sim->config[0x04] | (sim->config[0x05] << 8);
+    return period ? period : 1;
+}
+
+static void sim_boot_app(tmf8821_sim_t *sim)
+{
+    sim->mode = SIM_APP;
+    sim->measuring = false;
+    memset(sim->regs, 0, 0xE0);
+    sim->regs[0x00] = 0x03; // APPID: 测量应用
+    sim->regs[0x01] = TMF882X_IMAGE_APP_MAJOR;
+    sim->regs[0x12] = TMF882X_IMAGE_APP_MINOR;
+    sim->regs[0x13] = TMF882X_IMAGE_APP_PATCH;
+}
+
+// at: 帧按周期该出来的时间; 主机晚于它才轮询到时, INT仍按这个时间拉低
+static void sim_publish_frame(tmf8821_sim_t *sim, uint64_t at)
+{
+    uint8_t *r = sim->regs;
+    uint8_t rn = sim->result_number++;
+
+    memset(&r[0x20], 0, RESULT_PAGE_END - 0x20);
+    r[0x20] = RESULT_PAGE_ID;
+    r[0x22] = RESULT_PAGE_END - 0x24;
+    r[0x24] = rn;
+    r[0x25] = 25; // 温度
+    r[0x26] = 9;  // 有效结果数
+    uint32_t tick = (uint32_t)time_us_64();
+    memcpy(&r[0x34], &tick, 4);
+    // 分时复用的图: 开始测量后两组SPAD交替, 第二次子采集的各通道对应另外半幅的区
+    uint8_t map = sim->config[CFG_SPAD_MAP];
+    int channels = map == SPAD_MAP_4X4 ? 8 : 9;
+    int sub = map == SPAD_MAP_4X4 || map == SPAD_MAP_3X6 ? (uint8_t)(rn - sim->measure_result) % 2 : 0;
+    for (int zone = 0; zone < channels; zone++)
+    {
+        // 第一目标: 每区固定距离, 加上 ±1 mm 抖动
+        uint16_t dist = 0x55 + (sub * channels + zone) * 3 + (rn % 3) - 1 + (sim->calibrated ? 0 : SIM_UNCALIBRATED_MM);
+        r[0x38 + zone * 3] = 0xC8;
+        r[0x39 + zone * 3] = dist & 0xFF;
+        r[0x3A + zone * 3] = dist >> 8;
+    }
+
+    sim->frames++;
+    if (r[0xE2] & INT_RESULT)
+    {
+        if (r[0xE1] & INT_RESULT)
+            sim->frames_overrun++;
+        else if (!(r[0xE1] & r[0xE2]))
+            sim->int_at_us = at;
+        r[0xE1] |= INT_RESULT;
+    }
+}
+
+// 直方图包: 通道ch的第plane个字节平面, 每通道一个峰加本底
+static void sim_publish_hist(tmf8821_sim_t *sim, uint8_t index)
+{
+    uint8_t *r = sim->regs;
+    uint8_t ch = index / 3;
+    uint8_t plane = index % 3;
+
+    r[0x20] = HIST_PAGE_ID;
+    r[0x21] = index;
+    r[0x22] = HIST_PACKET_DATA;
+    r[0x23] = 0;
+    for (int b = 0; b < HIST_PACKET_DATA; b++)
+    {
+        int d = b - (20 + ch);
+        uint32_t count = 100 + (d * d < 16 ? 60000u >> (d * d) : 0) + sim->result_number;
+        r[0x24 + b] = (count >> (8 * plane)) & 0xFF;
+    }
+    if (r[0xE2] & INT_HIST)
+        r[0xE1] |= INT_HIST;
+}
+
+static void sim_complete_cmd(tmf8821_sim_t *sim)
+{
+    uint8_t cmd = sim->pending_cmd;
+    uint8_t status = sim->pending_status;
+    sim->pending_cmd = 0;
+
+    if (sim->mode == SIM_BOOTLOADER)
+    {
+        if (cmd == BL_CMD_RAMREMAP_RESET && status == BL_STAT_READY)
+        {
+            sim_boot_app(sim);
+            return;
+        }
+        sim->regs[0x08] = status;
+        sim->regs[0x09] = 0;
+        sim->regs[0x0A] = ~status;
+        return;
+    }
+
+    switch (cmd)
+    {
+    case APP_CMD_LOAD_CONFIG_COMMON:
+        memcpy(&sim->regs[0x20], sim->config, sizeof(sim->config));
+        sim->regs[0x20] = APP_CMD_LOAD_CONFIG_COMMON;
+        sim->regs[0x21] = 0;
+        sim->regs[0x22] = 0xBC;
+        sim->regs[0x23] = 0;
+        break;
+    case APP_CMD_LOAD_CONFIG_CALIB:
+        sim->regs[0x20] = APP_CMD_LOAD_CONFIG_CALIB;
+        sim->regs[0x21] = 0;
+        sim->regs[0x22] = TMF8821_SIM_CALIB_SIZE;
+        sim->regs[0x23] = 0;
+        memcpy(&sim->regs[0x24], sim->calib, TMF8821_SIM_CALIB_SIZE);
+        break;
+    case APP_CMD_FACTORY_CALIB:
+        // 数据由地址决定, 不同传感器的标定各不相同, 写回错了能查出来
+        for (int i = 0; i < TMF8821_SIM_CALIB_SIZE; i++)
+            sim->calib[i] = (sim->addr * 31 + i * 7) ^ 0x5A;
+        sim->calibrated = true;
+        break;
+    case APP_CMD_WRITE_CONFIG:
+        if (sim->regs[0x20] == APP_CMD_LOAD_CONFIG_COMMON)
+            memcpy(&sim->config[4], &sim->regs[0x24], sizeof(sim->config) - 4);
+        else if (sim->regs[0x20] == APP_CMD_LOAD_CONFIG_CALIB)
+        {
+            memcpy(sim->calib, &sim->regs[0x24], TMF8821_SIM_CALIB_SIZE);
+            sim->calibrated = true;
+        }
+        break;
+    case APP_CMD_MEASURE:
+        sim->measuring = true;
+        sim->measure_result = sim->result_number;
+        sim->next_frame_us = time_us_64() + sim_period_ms(sim) * 1000u;
+        status = APP_STAT_ACCEPTED;
+        break;
+    case APP_CMD_STOP:
+        sim->measuring = false;
+        sim->hist_next = HIST_IDLE;
+        break;
+    case APP_CMD_I2C_ADDRESS:
+        sim->addr = sim->config[CFG_I2C_ADDRESS] >> 1;
+        break;
+    default:
+        break;
+    }
+    sim->regs[0x08] = status;
+}
+
+static void sim_bl_command(tmf8821_sim_t *sim, const uint8_t *buf, size_t len)
+{
+    uint8_t cmd = buf[0];
+    uint8_t size = len > 1 ? buf[1] : 0;
+    if (len < 3u + size)
+        return; // 命令不完整, 引导程序不响应
+
+    uint16_t sum = cmd + size;
+    for (int i = 0; i < size; i++)
+        sum += buf[2 + i];
+    uint8_t status = BL_STAT_READY;
+    if ((uint8_t)~sum != buf[2 + size])
+        status = BL_STAT_ERR_CSUM;
+
+    if (status == BL_STAT_READY)
+    {
+        switch (cmd)
+        {
+        case BL_CMD_DOWNLOAD_INIT:
+            sim->ram_written = 0;
+            break;
+        case BL_CMD_SET_ADDR:
+            sim->ram_addr = (buf[2] << 8) | buf[3];
+            break;
+        case BL_CMD_W_RAM:
+            if (size > TMF8821_SIM_BL_MAX_DATA)
+                status = BL_STAT_ERR_SIZE;
+            else if (sim->ram_addr + size > TMF8821_SIM_RAM_SIZE)
+                status = BL_STAT_ERR_RANGE;
+            else
+            {
+                memcpy(&sim->ram[sim->ram_addr], &buf[2], size);
+                sim->ram_addr += size;
+                sim->ram_written += size;
+            }
+            break;
+        case BL_CMD_RAMREMAP_RESET:
+            if (sim->ram_written == 0)
+                status = BL_STAT_ERR_APP;
+            break;
+        default:
+            break;
+        }
+    }
+
+    sim->pending_cmd = cmd;
+    sim->pending_status = status;
+    sim->cmd_done_us = time_us_64() + (cmd == BL_CMD_RAMREMAP_RESET ? SIM_APP_BOOT_US : SIM_BL_CMD_US + size / 8);
+}
+
+static void sim_app_command(tmf8821_sim_t *sim, uint8_t cmd)
+{
+    sim->regs[0x08] = cmd;
+    sim->pending_cmd = cmd;
+    sim->pending_status = APP_STAT_OK;
+    sim->cmd_done_us = time_us_64() + (cmd == APP_CMD_FACTORY_CALIB ? SIM_CALIB_US : SIM_APP_CMD_US);
+}
+
+static void sim_write_reg(tmf8821_sim_t *sim, uint8_t reg, uint8_t val)
+{
+    switch (reg)
+    {
+    case 0xE0:
+        if ((val & 0x01) && !sim->powered)
+            sim->ready_at_us = time_us_64() + SIM_CPU_INIT_US;
+        if (!(val & 0x01) && sim->powered)
+        { // 待机: RAM里的固件和配置保留, 测量和在执行的命令停下
+            sim->measuring = false;
+            sim->pending_cmd = 0;
+            sim->standbys++;
+        }
+        sim->powered = val & 0x01;
+        sim->regs[0xE0] = val & 0x31;
+        break;
+    case 0xE1:
+        sim->regs[0xE1] &= ~val; // 写1清除
+        if ((val & INT_HIST) && sim->hist_next != HIST_IDLE)
+            sim->hist_at_us = time_us_64() + SIM_HIST_PACKET_US;
+        break;
+    default:
+        sim->regs[reg] = val;
+        break;
+    }
+}
+
+static uint8_t sim_read_reg(tmf8821_sim_t *sim, uint8_t reg)
+{
+    if (reg == 0xE0)
+    {
+        if (!sim->powered)
+            return 0x02;
+        if (time_us_64() < sim->ready_at_us)
+            return (sim->regs[0xE0] & 0x30) | 0x01;
+        return (sim->regs[0xE0] & 0x30) | 0x41;
+    }
+    return sim->regs[reg];
+}
+
+static void sim_step(tmf8821_sim_t *sim)
+{
+    uint64_t now = time_us_64();
+    if (!sim->powered)
+        return;
+    if (sim->pending_cmd && now >= sim->cmd_done_us)
+        sim_complete_cmd(sim);
+    while (sim->measuring && now >= sim->next_frame_us)
+    {
+        if (sim->hist_next != HIST_IDLE)
+            sim->frames_skipped++;
+        else if (sim->config[CFG_HIST_DUMP] & 0x01)
+        {
+            sim->hist_next = 0;
+            sim->hist_at_us = sim->next_frame_us;
+        }
+        else
+            sim_publish_frame(sim, sim->next_frame_us);
+        sim->next_frame_us += sim_period_ms(sim) * 1000u;
+    }
+
+    // 直方图包逐个发送, 主机清掉INT_HIST后才发下一包, 全部发完再发结果
+    if (sim->hist_next != HIST_IDLE && !(sim->regs[0xE1] & INT_HIST) && now >= sim->hist_at_us)
+    {
+        if (sim->hist_next < HIST_PACKETS)
+            sim_publish_hist(sim, sim->hist_next++);
+        else
+        {
+            sim->hist_next = HIST_IDLE;
+            sim->hist_captures++;
+            sim_publish_frame(sim, now);
+        }
+    }
+}
+
+// 使能脚为低时掉电: 寄存器、配置和地址都回到上电状态
+static bool sim_enabled(tmf8821_sim_t *sim)
+{
+    bool on = sim->pin_en == TMF8821_SIM_NO_PIN || gpio_get(sim->pin_en);
+    if (!on && sim->en_on)
+    {
+        tmf8821_sim_t saved = *sim;
+        tmf8821_sim_init(sim, saved.bus_hz);
+        sim->pin_en = saved.pin_en;
+        sim->transport = saved.transport;
+        sim->frames = saved.frames;
+        sim->frames_overrun = saved.frames_overrun;
+        sim->fault_nack_every = saved.fault_nack_every;
+        sim->fault_stuck_every = saved.fault_stuck_every;
+        sim->faults = saved.faults;
+    }
+    sim->en_on = on;
+    return on;
+}
+
+// 寻址到本机的一次传输按设定注入NACK或卡死总线
+static int sim_fault(tmf8821_sim_t *sim)
+{
+    sim->transfers++;
+    if (sim->fault_stuck_every && sim->transfers % sim->fault_stuck_every == 0)
+    {
+        sim->stuck = true;
+        sim->faults++;
+        host_clock_advance_ns(TMF8821_SIM_TIMEOUT_US * 1000u);
+        return I2C_ERR_TIMEOUT;
+    }
+    if (sim->fault_nack_every && sim->transfers % sim->fault_nack_every == 0)
+    {
+        sim->faults++;
+        return I2C_ERR_NACK;
+    }
+    return 0;
+}
+
+static int sim_handle_write(tmf8821_sim_t *sim, uint8_t addr, const uint8_t *src, size_t len)
+{
+    if (!sim_enabled(sim))
+        return I2C_ERR_NACK;
+    sim_step(sim); // 地址不是自己的也推进内部状态, 改址命令完成后才在新地址应答
+    if (addr != sim->addr || len == 0)
+        return I2C_ERR_NACK;
+    int fault = sim_fault(sim);
+    if (fault)
+        return fault;
+
+    sim->ptr = src[0];
+    if (len == 1)
+        return 1;
+    if (sim->ptr == 0x08 && sim->mode == SIM_BOOTLOADER)
+    {
+        memcpy(&sim->regs[0x08], &src[1], len - 1 > 0xF8 ? 0xF8 : len - 1);
+        sim_bl_command(sim, &src[1], len - 1);
+    }
+    else if (sim->ptr == 0x08)
+        sim_app_command(sim, src[1]);
+    else
+    {
+        for (size_t i = 1; i < len; i++)
+            sim_write_reg(sim, sim->ptr++, src[i]);
+    }
+    return (int)len;
+}
+
+static int sim_handle_read(tmf8821_sim_t *sim, uint8_t addr, uint8_t *dst, size_t len)
+{
+    if (!sim_enabled(sim))
+        return I2C_ERR_NACK;
+    sim_step(sim);
+    if (addr != sim->addr)
+        return I2C_ERR_NACK;
+    int fault = sim_fault(sim);
+    if (fault)
+        return fault;
+
+    for (size_t i = 0; i < len; i++)
+        dst[i] = sim_read_reg(sim, sim->ptr++);
+    return (int)len;
+}
+
+// SDA被拉死时任何传输都只能等到超时
+static bool sim_stuck(tmf8821_sim_t *const *sims, uint8_t count)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (sims[i]->stuck)
+        {
+            host_clock_advance_ns(TMF8821_SIM_TIMEOUT_US * 1000u);
+            return true;
+        }
+    }
+    return false;
+}
+
+// 总线恢复: 9个SCL时钟加STOP, 放开所有卡住的从机
+static void sim_unstick(tmf8821_sim_t *const *sims, uint8_t count, uint32_t bus_hz)
+{
+    host_clock_advance_ns(10 * 1000000000ull / bus_hz);
+    for (uint8_t i = 0; i < count; i++)
+        sims[i]->stuck = false;
+}
+
+static int sim_write(void *ctx, uint8_t addr, const uint8_t *src, size_t len, bool nostop)
+{
+    tmf8821_sim_t *sim = ctx;
+    if (sim_stuck(&sim, 1))
+        return I2C_ERR_TIMEOUT;
+    sim_wire(sim->bus_hz, len, nostop);
+    return sim_handle_write(sim, addr, src, len);
+}
+
+static int sim_read(void *ctx, uint8_t addr, uint8_t *dst, size_t len, bool nostop)
+{
+    tmf8821_sim_t *sim = ctx;
+    if (sim_stuck(&sim, 1))
+        return I2C_ERR_TIMEOUT;
+    sim_wire(sim->bus_hz, len, nostop);
+    return sim_handle_read(sim, addr, dst, len);
+}
+
+static void sim_recover(void *ctx)
+{
+    tmf8821_sim_t *sim = ctx;
+    sim_unstick(&sim, 1, sim->bus_hz);
+}
+
+// 共享总线: 线上时间只算一次, 由地址匹配的传感器应答
+static int bus_write(void *ctx, uint8_t addr, const uint8_t *src, size_t len, bool nostop)
+{
+    tmf8821_sim_bus_t *bus = ctx;
+    int result = I2C_ERR_NACK;
+    if (sim_stuck(bus->sims, bus->count))
+        return I2C_ERR_TIMEOUT;
+    sim_wire(bus->bus_hz, len, nostop);
+    for (uint8_t i = 0; i < bus->count && result == I2C_ERR_NACK; i++)
+        result = sim_handle_write(bus->sims[i], addr, src, len);
+    return result;
+}
+
+static int bus_read(void *ctx, uint8_t addr, uint8_t *dst, size_t len, bool nostop)
+{
+    tmf8821_sim_bus_t *bus = ctx;
+    int result = I2C_ERR_NACK;
+    if (sim_stuck(bus->sims, bus->count))
+        return I2C_ERR_TIMEOUT;
+    sim_wire(bus->bus_hz, len, nostop);
+    for (uint8_t i = 0; i < bus->count && result == I2C_ERR_NACK; i++)
+        result = sim_handle_read(bus->sims[i], addr, dst, len);
+    return result;
+}
+
+static void bus_recover(void *ctx)
+{
+    tmf8821_sim_bus_t *bus = ctx;
+    sim_unstick(bus->sims, bus->count, bus->bus_hz);
+}
+
+void tmf8821_sim_init(tmf8821_sim_t *sim, uint32_t bus_hz)
+{
+    memset(sim, 0, sizeof(*sim));
+    sim->addr = I2C_ADDRESS;
+    sim->pin_en = TMF8821_SIM_NO_PIN;
+    sim->bus_hz = bus_hz;
+    sim->mode = SIM_BOOTLOADER;
+    sim->regs[0x00] = 0x80; // APPID: 引导程序
+    sim->hist_next = HIST_IDLE;
+
+    // 公共配置默认值
+    sim->config[0x04] = 33;   // 周期 33ms
+    sim->config[0x06] = 0x19; // 537 千次迭代
+    sim->config[0x07] = 0x02;
+    sim->config[0x10] = 6;    // 置信度阈值
+    sim->config[0x14] = 1;    // SPAD map 1
+
+    sim->transport.write = sim_write;
+    sim->transport.read = sim_read;
+    sim->transport.ctx = sim;
+    sim->transport.recover = sim_recover;
+}
+
+// 把模拟器挂到驱动的I²C传输层上
+void tmf8821_sim_attach(tmf8821_sim_t *sim)
+{
+    i2c_set_transport(&sim->transport, sim->bus_hz);
+}
+
+void tmf8821_sim_bus_init(tmf8821_sim_bus_t *bus, uint32_t bus_hz)
+{
+    memset(bus, 0, sizeof(*bus));
+    bus->bus_hz = bus_hz;
+    bus->transport.write = bus_write;
+    bus->transport.read = bus_read;
+    bus->transport.ctx = bus;
+    bus->transport.recover = bus_recover;
+}
+
+// 把一个模拟器挂到共享总线上, 使能脚为pin_en
+void tmf8821_sim_bus_add(tmf8821_sim_bus_t *bus, tmf8821_sim_t *sim, uint8_t pin_en)
+{
+    if (bus->count < TMF8821_SIM_BUS_MAX)
+        bus->sims[bus->count++] = sim;
+    sim->pin_en = pin_en;
+    sim->bus_hz = bus->bus_hz;
+}
+
+bool tmf8821_sim_int_asserted(tmf8821_sim_t *sim)
+{
+    if (!sim_enabled(sim))
+        return false;
+    sim_step(sim);
+    return (sim->regs[0xE1] & sim->regs[0xE2]) != 0;
+}
+
+// 下一个内部事件(命令完成/结果帧)的时间, 没有则返回UINT64_MAX
+uint64_t tmf8821_sim_next_event_us(tmf8821_sim_t *sim)
+{
+    uint64_t next = UINT64_MAX;
+    if (!sim_enabled(sim))
+        return next;
+    if (sim->pending_cmd)
+        next = sim->cmd_done_us;
+    if (sim->measuring && sim->next_frame_us < next)
+        next = sim->next_frame_us;
+    if (sim->hist_next != HIST_IDLE && !(sim->regs[0xE1] & INT_HIST) && sim->hist_at_us < next)
+        next = sim->hist_at_us;
+    return next;
+}
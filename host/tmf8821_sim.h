@@ -0,0 +1,82 @@
+#ifndef TMF8821_SIM_H
+#define TMF8821_SIM_H
+
+// 寄存器级TMF8821模拟器: 引导程序(W_RAM/SET_ADDR/RAMREMAP_RESET)、
+// CMD_STAT状态机、公共配置页和标定页、0x20结果页和结果中断
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "i2c_usr.h"
+
+#define TMF8821_SIM_RAM_SIZE 0x2000
+#define TMF8821_SIM_BL_MAX_DATA 0x80
+#define TMF8821_SIM_NO_PIN 0xFF
+#define TMF8821_SIM_BUS_MAX 4
+#define TMF8821_SIM_TIMEOUT_US 2000 // 总线卡死时主机等到超时的时间
+#define TMF8821_SIM_CALIB_SIZE 188
+
+typedef enum
+{
+    SIM_BOOTLOADER,
+    SIM_APP,
+} tmf8821_sim_mode_t;
+
+typedef struct
+{
+    uint8_t addr;
+    uint8_t pin_en;            // 使能脚, 低电平时掉电不应答; TMF8821_SIM_NO_PIN为常开
+    bool en_on;
+    uint32_t bus_hz;
+    tmf8821_sim_mode_t mode;
+    bool powered;              // ENABLE.PON, 清零为待机
+    uint32_t standbys;
+    uint8_t regs[256];
+    uint8_t config[0x20];      // 已提交的公共配置(0x20..0x3F)
+    uint8_t calib[TMF8821_SIM_CALIB_SIZE];
+    bool calibrated;           // 做过工厂标定或写回过标定, 掉电后丢失
+    uint8_t ram[TMF8821_SIM_RAM_SIZE];
+    uint16_t ram_addr;
+    uint32_t ram_written;
+    uint8_t ptr;               // 寄存器自增指针
+    uint64_t ready_at_us;      // CPU就绪时间
+    uint8_t pending_cmd;       // 正在执行的命令
+    uint8_t pending_status;
+    uint64_t cmd_done_us;
+    bool measuring;
+    uint64_t next_frame_us;
+    uint8_t result_number;
+    uint8_t measure_result;    // 开始测量时的结果编号, 分时复用的子采集从这里起交替
+    uint32_t frames;           // 产生的结果帧数
+    uint32_t frames_overrun;   // 上一帧中断未清除时产生的新帧
+    uint64_t int_at_us;        // 最近一次因结果帧拉低INT的时间(按帧周期, 不是主机轮询到的时间)
+    uint8_t hist_next;         // 下一个要发的直方图包号, 0xFF为空闲
+    uint64_t hist_at_us;
+    uint32_t hist_captures;    // 完整发完的直方图组
+    uint32_t frames_skipped;   // 直方图还没被读完时错过的测量周期
+    // 故障注入(0为关闭): 每fault_nack_every次寻址到本机的传输NACK一次,
+    // 每fault_stuck_every次把SDA拉死, 之后整条总线超时, 直到主机做总线恢复
+    uint32_t fault_nack_every;
+    uint32_t fault_stuck_every;
+    uint32_t transfers;
+    bool stuck;
+    uint32_t faults;           // 注入的故障次数
+    i2c_transport_t transport;
+} tmf8821_sim_t;
+
+// 一条总线上挂多个模拟器, 按地址分发
+typedef struct
+{
+    tmf8821_sim_t *sims[TMF8821_SIM_BUS_MAX];
+    uint8_t count;
+    uint32_t bus_hz;
+    i2c_transport_t transport;
+} tmf8821_sim_bus_t;
+
+void tmf8821_sim_init(tmf8821_sim_t *sim, uint32_t bus_hz);
+void tmf8821_sim_bus_init(tmf8821_sim_bus_t *bus, uint32_t bus_hz);
+void tmf8821_sim_bus_add(tmf8821_sim_bus_t *bus, tmf8821_sim_t *sim, uint8_t pin_en);
+void tmf8821_sim_attach(tmf8821_sim_t *sim);
+bool tmf8821_sim_int_asserted(tmf8821_sim_t *sim);
+uint64_t tmf8821_sim_next_event_us(tmf8821_sim_t *sim);
+
+#endif
@@ -0,0 +1,400 @@
+// 跟踪报告: 从数据口录下的二进制流(串口't'导出)里取出跟踪包, 统计
+// 中断到帧就绪、每帧总线时间、帧间隔、中断耗时和入队到发出的延迟, 打印分位数和直方图;
+// 流里的二进制日志包('l')按消息表格式化后打到stdout.
+// 用法: trace_report capture.bin
+//       trace_report [bus_hz] [profile] [sensors]   不给录像时在模拟传感器上跑同样的中断流程再导出
+// 驱动日志走stdout, 报告走stderr
+
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "tmf8821.h"
+#include "tmf882x_image.h"
+#include "tmf8821_sim.h"
+#include "sensor_array.h"
+#include "frame_queue.h"
+#include "frame_decoder.h"
+#include "trace.h"
+
+#define SIM_RUN_US 2000000
+#define PIN_EN_BASE 10
+#define PIN_INT_BASE 20
+#define HIST_BUCKETS 20 // 按2的幂分桶, 最后一桶 >= 2^19 µs
+
+typedef struct
+{
+    const char *name;
+    uint32_t *v;
+    uint32_t count;
+    uint32_t cap;
+} series_t;
+
+enum
+{
+    S_IRQ_TO_READY,
+    S_BUS_PER_FRAME,
+    S_FRAME_INTERVAL,
+    S_IRQ_TIME,
+    S_IRQ_TO_OUT,
+    SERIES
+};
+
+static series_t series[SERIES] = {
+    [S_IRQ_TO_READY] = {.name = "irq -> frame ready"},
+    [S_BUS_PER_FRAME] = {.name = "bus time per frame"},
+    [S_FRAME_INTERVAL] = {.name = "frame interval"},
+    [S_IRQ_TIME] = {.name = "irq duration"},
+    [S_IRQ_TO_OUT] = {.name = "irq -> usb out"},
+};
+
+// 每个核上一个正在进行的中断
+typedef struct
+{
+    bool open;
+    bool result;
+    uint8_t sensor;
+    uint32_t enter_us;
+    uint32_t bus_us;
+} irq_state_t;
+
+static irq_state_t irq[TRACE_CORES];
+static bool has_ready[16];
+static uint32_t last_ready[16];
+// DMA取帧时帧在DMA完成中断里就绪, 不在GPIO中断里: 按传感器记进中断时间和DMA序列耗时
+static uint32_t irq_enter[16];
+static bool dma_done[16];
+static uint32_t dma_bus_us[16];
+static uint32_t events, drops, commands, command_errors, unmatched;
+
+static void add(int s, uint32_t v)
+{
+    series_t *se = &series[s];
+    if (se->count == se->cap)
+    {
+        se->cap = se->cap ? se->cap * 2 : 1024;
+        se->v = realloc(se->v, se->cap * sizeof(uint32_t));
+    }
+    se->v[se->count++] = v;
+}
+
+// 按时间顺序处理一个核的事件; 环里最早的几条可能缺了开头, 配不上对的丢掉
+static void on_event(uint8_t core, const trace_event_t *e)
+{
+    irq_state_t *q = &irq[core % TRACE_CORES];
+    events++;
+    switch (e->id)
+    {
+    case TRACE_IRQ_ENTER:
+        *q = (irq_state_t){.open = true, .sensor = e->a8 & 0x0F, .enter_us = e->t_us};
+        irq_enter[q->sensor] = e->t_us;
+        break;
+    case TRACE_DMA_DONE:
+        dma_done[e->a8 & 0x0F] = e->a16 != 0xFFFF;
+        dma_bus_us[e->a8 & 0x0F] = e->a16;
+        break;
+    case TRACE_I2C:
+        if (q->open)
+            q->bus_us += e->a16;
+        break;
+    case TRACE_RESULT_READ:
+        q->result = e->a8;
+        break;
+    case TRACE_FRAME_READY:
+        if (!q->open && dma_done[e->a8 & 0x0F])
+        {
+            uint8_t sensor = e->a8 & 0x0F;
+            dma_done[sensor] = false;
+            add(S_IRQ_TO_READY, e->t_us - irq_enter[sensor]);
+            add(S_BUS_PER_FRAME, dma_bus_us[sensor]);
+            if (has_ready[sensor])
+                add(S_FRAME_INTERVAL, e->t_us - last_ready[sensor]);
+            has_ready[sensor] = true;
+            last_ready[sensor] = e->t_us;
+            break;
+        }
+        if (!q->open)
+        {
+            unmatched++;
+            break;
+        }
+        add(S_IRQ_TO_READY, e->t_us - q->enter_us);
+        if (q->result)
+        { // 直方图包不算帧间隔
+            if (has_ready[q->sensor])
+                add(S_FRAME_INTERVAL, e->t_us - last_ready[q->sensor]);
+            has_ready[q->sensor] = true;
+            last_ready[q->sensor] = e->t_us;
+        }
+        break;
+    case TRACE_FRAME_DROP:
+        drops++;
+        break;
+    case TRACE_IRQ_EXIT:
+        if (!q->open)
+        {
+            unmatched++;
+            break;
+        }
+        add(S_IRQ_TIME, e->t_us - q->enter_us);
+        if (q->result)
+            add(S_BUS_PER_FRAME, q->bus_us);
+        q->open = false;
+        break;
+    case TRACE_FRAME_OUT:
+        add(S_IRQ_TO_OUT, e->a16);
+        break;
+    case TRACE_CMD_DONE:
+        commands++;
+        command_errors += e->a16 != 0;
+        break;
+    default:
+        break;
+    }
+}
+
+static void on_trace(const proto_trace_t *trace, void *user)
+{
+    (void)user;
+    for (uint8_t i = 0; i < trace->count; i++)
+        on_event(trace->core, &trace->events[i]);
+}
+
+static void on_log(const proto_log_t *log, void *user)
+{
+    char line[128];
+    (void)user;
+    for (uint8_t i = 0; i < log->count; i++)
+    {
+        log_format(&log->records[i], line, sizeof(line));
+        printf("core%u %s\n", log->core, line);
+    }
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t percentile(const series_t *se, uint32_t p)
+{
+    return se->v[(uint64_t)(se->count - 1) * p / 100];
+}
+
+static void report(void)
+{
+    fprintf(stderr, "%u events, %u frames dropped, %u commands (%u failed), %u unmatched\n", events, drops,
+            commands, command_errors, unmatched);
+    fprintf(stderr, "%-20s %7s %8s %8s %8s %8s %8s %8s\n", "(us)", "count", "min", "p50", "p90", "p99", "max",
+            "mean");
+    for (int s = 0; s < SERIES; s++)
+    {
+        series_t *se = &series[s];
+        if (se->count == 0)
+        {
+            fprintf(stderr, "%-20s %7u\n", se->name, 0u);
+            continue;
+        }
+        qsort(se->v, se->count, sizeof(uint32_t), cmp_u32);
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < se->count; i++)
+            sum += se->v[i];
+        fprintf(stderr, "%-20s %7u %8u %8u %8u %8u %8u %8.1f\n", se->name, se->count, se->v[0],
+                percentile(se, 50), percentile(se, 90), percentile(se, 99), se->v[se->count - 1],
+                (double)sum / se->count);
+    }
+
+    for (int s = 0; s < SERIES; s++)
+    {
+        series_t *se = &series[s];
+        uint32_t buckets[HIST_BUCKETS] = {0}, peak = 0;
+        int lo = HIST_BUCKETS, hi = 0;
+        if (se->count == 0)
+            continue;
+        for (uint32_t i = 0; i < se->count; i++)
+        {
+            int b = 0;
+            while (b < HIST_BUCKETS - 1 && se->v[i] >= (2u << b))
+                b++;
+            buckets[b]++;
+        }
+        for (int b = 0; b < HIST_BUCKETS; b++)
+        {
+            if (buckets[b])
+            {
+                lo = b < lo ? b : lo;
+                hi = b;
+                peak = buckets[b] > peak ? buckets[b] : peak;
+            }
+        }
+        fprintf(stderr, "%s:\n", se->name);
+        for (int b = lo; b <= hi; b++)
+        {
+            char bar[41];
+            int n = (int)((uint64_t)buckets[b] * 40 / peak);
+            memset(bar, '#', n);
+            bar[n] = 0;
+            fprintf(stderr, "  %7u .. %7u us %7u %s\n", b ? 1u << b : 0u, (2u << b) - 1, buckets[b], bar);
+        }
+        free(se->v);
+    }
+}
+
+static bool load_capture(const char *path, frame_decoder_t *dec)
+{
+    uint8_t buf[4096];
+    size_t n;
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        frame_decoder_feed(dec, buf, n);
+    fclose(f);
+    return true;
+}
+
+// 模拟运行: 中断流程与gpio_callback相同, 主循环一侧在中断之后立即取走并"发出"
+static tmf8821_sim_t sims[SENSOR_MAX];
+static tmf8821_sim_bus_t bus;
+static tmf8821_dev_t devs[SENSOR_MAX];
+static sensor_array_t array;
+static frame_queue_t queue;
+
+static void sim_isr(uint8_t sensor)
+{
+    TRACE(TRACE_IRQ_ENTER, sensor, devs[sensor].pin_int);
+    uint32_t start = time_us_32();
+    tmf8821_select(&devs[sensor]);
+    uint8_t status = i2c_read_byte(INT_CLEAR_REG);
+    if (status & (INT_HIST | INT_RESULT))
+    {
+        result_frame_t *slot = frame_queue_claim(&queue);
+        if (slot != NULL)
+        {
+            slot->timestamp_us = start;
+            slot->sensor = sensor;
+            bool ok = (status & INT_HIST) ? read_hist_packet(slot->data) : read_result_frame(slot->data);
+            if (ok)
+            {
+                frame_queue_commit(&queue);
+                TRACE(TRACE_FRAME_READY, sensor, (status & INT_HIST) ? slot->data[1] : slot->data[4]);
+            }
+            else
+                frame_queue_discard(&queue);
+        }
+        else
+            TRACE(TRACE_FRAME_DROP, sensor, 0);
+    }
+    i2c_write_byte(INT_CLEAR_REG, status);
+    TRACE(TRACE_IRQ_EXIT, sensor, status);
+
+    result_frame_t frame;
+    while (frame_queue_read(&queue, &frame, 1))
+        TRACE(TRACE_FRAME_OUT, frame.sensor, time_us_32() - frame.timestamp_us);
+}
+
+static void simulate(uint32_t bus_hz, const tmf8821_config_t *profile, uint8_t count, frame_decoder_t *dec)
+{
+    const uint8_t app_version[3] = {TMF882X_IMAGE_APP_MAJOR, TMF882X_IMAGE_APP_MINOR, TMF882X_IMAGE_APP_PATCH};
+
+    tmf8821_sim_bus_init(&bus, bus_hz);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        tmf8821_sim_init(&sims[i], bus_hz);
+        tmf8821_sim_bus_add(&bus, &sims[i], PIN_EN_BASE + i);
+        devs[i] = (tmf8821_dev_t){.bus = &bus.transport, .bus_hz = bus_hz, .addr = I2C_ADDRESS + 1 + i,
+                                  .pin_en = PIN_EN_BASE + i, .pin_int = PIN_INT_BASE + i};
+    }
+    sensor_array_init(&array, devs, count);
+    sensor_array_bringup(&array, tmf882x_image, tmf882x_image_length, app_version);
+    sensor_array_configure(&array, profile);
+    sensor_array_start(&array, profile->period_ms);
+
+    uint64_t until = time_us_64() + SIM_RUN_US;
+    while (time_us_64() < until)
+    {
+        int sensor = -1;
+        uint64_t next = UINT64_MAX;
+        for (uint8_t i = 0; i < count && sensor < 0; i++)
+        {
+            if (tmf8821_sim_int_asserted(&sims[i]))
+                sensor = i;
+            else if (tmf8821_sim_next_event_us(&sims[i]) < next)
+                next = tmf8821_sim_next_event_us(&sims[i]);
+        }
+        if (sensor >= 0)
+            sim_isr(sensor);
+        else
+        {
+            uint64_t now = time_us_64();
+            host_clock_advance_ns(next != UINT64_MAX && next > now ? (next - now) * 1000u : 1000u);
+        }
+    }
+    sensor_array_stop(&array);
+
+    // 与固件的't'一样: 暂停, 按核分包编码, 再经解码器读回
+    uint8_t packet[PROTO_MAX_PACKET];
+    trace_event_t chunk[PROTO_TRACE_EVENTS];
+    uint16_t seq = 0;
+    trace_pause(true);
+    for (uint8_t core = 0; core < TRACE_CORES; core++)
+    {
+        uint32_t total = trace_count(core);
+        for (uint32_t pos = 0; pos < total; pos += PROTO_TRACE_EVENTS)
+        {
+            uint32_t n = total - pos < PROTO_TRACE_EVENTS ? total - pos : PROTO_TRACE_EVENTS;
+            for (uint32_t i = 0; i < n; i++)
+                chunk[i] = trace_get(core, pos + i);
+            frame_decoder_feed(dec, packet, proto_encode_trace(core, seq++, time_us_32(), chunk, n, packet));
+        }
+    }
+    trace_clear();
+    trace_pause(false);
+
+    // 驱动日志走同样的路: 打包、解码, 由on_log格式化
+    log_record_t records[PROTO_LOG_RECORDS];
+    uint8_t n;
+    do
+    {
+        for (n = 0; n < PROTO_LOG_RECORDS && log_take(0, &records[n]); n++)
+            ;
+        if (n)
+            frame_decoder_feed(dec, packet, proto_encode_log(0, seq++, time_us_32(), records, n, packet));
+    } while (n);
+}
+
+int main(int argc, char **argv)
+{
+    frame_decoder_t dec;
+    frame_decoder_init(&dec, NULL, NULL);
+    dec.on_trace = on_trace;
+    dec.on_log = on_log;
+
+    char *end = NULL;
+    uint32_t bus_hz = argc > 1 ? strtoul(argv[1], &end, 0) : I2C_BUS_HZ;
+    if (argc > 1 && *end != 0)
+    {
+        if (!load_capture(argv[1], &dec))
+            return 1;
+        fprintf(stderr, "%s: %u trace packets, %u log packets, %u crc errors, %u framing errors\n", argv[1],
+                dec.trace_packets, dec.log_packets, dec.crc_errors, dec.framing_errors);
+    }
+    else
+    {
+        const tmf8821_config_t *profile = tmf8821_find_profile(argc > 2 ? argv[2] : "default");
+        uint8_t count = argc > 3 ? strtoul(argv[3], NULL, 0) : 2;
+        if (!profile || count < 1 || count > SENSOR_MAX)
+        {
+            fprintf(stderr, "usage: trace_report capture.bin | [bus_hz] [profile] [sensors]\n");
+            return 1;
+        }
+        simulate(bus_hz, profile, count, &dec);
+        fprintf(stderr, "simulated %u sensor(s), bus %u Hz, profile %s: %u trace packets, %u log packets\n", count,
+                bus_hz, profile->name, dec.trace_packets, dec.log_packets);
+    }
+    report();
+    return 0;
+}
@@ -0,0 +1,103 @@
+// 区模式基准: 一个模拟传感器依次跑3x3和分时复用的4x4、3x6配置, 结果页按结果编号拼成深度图,
+// 经深度图包编码再解码, 统计每种模式的结果页速率、有效深度图帧率、作废的幅数和有目标的区数.
+// 中途丢一个子帧时, 那一幅应作废, 后面的幅照常拼齐.
+// 用法: zone_bench [bus_hz]   驱动日志走stdout, 报告走stderr
+
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "tmf8821.h"
+#include "tmf882x_image.h"
+#include "tmf8821_sim.h"
+#include "sensor_array.h"
+#include "depth_frame.h"
+#include "frame_proto.h"
+#include "frame_decoder.h"
+#include "log.h"
+
+#define RUN_US 2000000
+#define DROP_AT 10 // 第几个结果页故意不交给拼装, 模拟丢帧
+#define PIN_EN 10
+#define PIN_INT 20
+
+static tmf8821_sim_t sim;
+static tmf8821_sim_bus_t bus;
+static tmf8821_dev_t dev;
+static sensor_array_t array;
+static proto_depth_t last;
+
+static void on_depth(const proto_depth_t *depth, void *user)
+{
+    (void)user;
+    last = *depth;
+}
+
+static void run(uint32_t bus_hz, const tmf8821_config_t *profile)
+{
+    const uint8_t app_version[3] = {TMF882X_IMAGE_APP_MAJOR, TMF882X_IMAGE_APP_MINOR, TMF882X_IMAGE_APP_PATCH};
+    const tmf8821_spad_map_t *map = tmf8821_find_spad_map(profile->spad_map_id);
+    uint8_t packet[PROTO_MAX_PACKET];
+    tmf8821_frame_t frame;
+    depth_assembler_t assembler;
+    frame_decoder_t dec;
+    uint32_t pages = 0;
+
+    tmf8821_sim_bus_init(&bus, bus_hz);
+    tmf8821_sim_init(&sim, bus_hz);
+    tmf8821_sim_bus_add(&bus, &sim, PIN_EN);
+    dev = (tmf8821_dev_t){.bus = &bus.transport, .bus_hz = bus_hz, .addr = I2C_ADDRESS + 1, .pin_en = PIN_EN,
+                          .pin_int = PIN_INT};
+    sensor_array_init(&array, &dev, 1);
+    sensor_array_bringup(&array, tmf882x_image, tmf882x_image_length, app_version);
+    sensor_array_configure(&array, profile);
+    frame_decoder_init(&dec, NULL, NULL);
+    dec.on_depth = on_depth;
+    memset(&last, 0, sizeof(last));
+    depth_assembler_init(&assembler, map);
+    sensor_array_start(&array, profile->period_ms);
+
+    uint64_t start = time_us_64(), until = start + RUN_US;
+    while (time_us_64() < until)
+    {
+        if (!tmf8821_sim_int_asserted(&sim))
+        {
+            uint64_t now = time_us_64(), next = tmf8821_sim_next_event_us(&sim);
+            host_clock_advance_ns(next > now ? (next - now) * 1000u : 1000u);
+            continue;
+        }
+        tmf8821_select(&dev);
+        uint8_t status = i2c_read_byte(INT_CLEAR_REG);
+        if ((status & INT_RESULT) && read_result_frame((uint8_t *)&frame) && pages++ != DROP_AT &&
+            depth_assembler_add(&assembler, &frame, time_us_32()))
+            frame_decoder_feed(&dec, packet, proto_encode_depth(&assembler.frame, 0, 0, packet));
+        i2c_write_byte(INT_CLEAR_REG, status);
+    }
+    sensor_array_stop(&array);
+    log_drain(LOG_RECORDS);
+
+    // 拼好的一幅里有目标的区, 距离各不相同才说明两次子采集各自落在了自己的半幅
+    uint8_t zones = last.frame.rows * last.frame.cols, filled = 0, distinct = 0;
+    for (uint8_t z = 0; z < zones; z++)
+    {
+        filled += last.frame.zones[0][z].confidence != 0;
+        bool unique = true;
+        for (uint8_t k = 0; k < z; k++)
+            unique &= last.frame.zones[0][k].distance_mm != last.frame.zones[0][z].distance_mm;
+        distinct += unique;
+    }
+    double seconds = (time_us_64() - start) / 1e6;
+    fprintf(stderr, "%-9s %-9s %ux%-2u %3u ms  %6.1f pages/s %6.1f frames/s  %2u incomplete  %u/%u zones, %u distinct\n",
+            profile->name, map->name, map->rows, map->cols, profile->period_ms, pages / seconds,
+            dec.depth_frames / seconds, assembler.incomplete, filled, zones, distinct);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t bus_hz = argc > 1 ? strtoul(argv[1], NULL, 0) : I2C_BUS_HZ;
+    const char *names[] = {"default", "4x4", "3x6"};
+
+    fprintf(stderr, "bus %u Hz, %u s per mode, page %u dropped\n", bus_hz, RUN_US / 1000000, DROP_AT);
+    for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+        run(bus_hz, tmf8821_find_profile(names[i]));
+    return 0;
+}
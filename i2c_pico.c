@@ -0,0 +1,90 @@
+#include "i2c_usr.h"
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+
+#define I2C_PORT i2c0
+
+// 两条硬件总线: i2c0 在GPIO16/17, i2c1 在GPIO18/19
+static const uint8_t pico_sda[I2C_PICO_BUSES] = {16, 18};
+static uint32_t pico_hz[I2C_PICO_BUSES];
+
+static uint8_t pico_index(void *ctx)
+{
+    return (i2c_inst_t *)ctx == I2C_PORT ? 0 : 1;
+}
+
+// 超时按线上时间的两倍加余量; SDK的NACK返回PICO_ERROR_GENERIC
+static uint32_t pico_timeout_us(void *ctx, size_t len)
+{
+    return I2C_TIMEOUT_BASE_US + 2 * (len + 1) * 9 * 1000000ull / pico_hz[pico_index(ctx)];
+}
+
+static int pico_result(int result)
+{
+    if (result == PICO_ERROR_TIMEOUT)
+        return I2C_ERR_TIMEOUT;
+    return result < 0 ? I2C_ERR_NACK : result;
+}
+
+static int pico_write(void *ctx, uint8_t addr, const uint8_t *src, size_t len, bool nostop)
+{
+    return pico_result(i2c_write_timeout_us((i2c_inst_t *)ctx, addr, src, len, nostop, pico_timeout_us(ctx, len)));
+}
+
+static int pico_read(void *ctx, uint8_t addr, uint8_t *dst, size_t len, bool nostop)
+{
+    return pico_result(i2c_read_timeout_us((i2c_inst_t *)ctx, addr, dst, len, nostop, pico_timeout_us(ctx, len)));
+}
+
+// 总线恢复: 从机卡在读到一半时会一直拉低SDA. 切到GPIO开漏方式打最多9个SCL时钟
+// 直到SDA释放, 再发STOP, 最后重新初始化控制器(i2c_init会复位外设)
+static void pico_recover(void *ctx)
+{
+    uint8_t index = pico_index(ctx);
+    uint sda = pico_sda[index], scl = sda + 1;
+    uint32_t half_us = 500000 / pico_hz[index] + 1;
+
+    gpio_set_function(sda, GPIO_FUNC_SIO);
+    gpio_set_function(scl, GPIO_FUNC_SIO);
+    gpio_put(sda, 0); // 开漏: 输出为拉低, 输入为释放
+    gpio_put(scl, 0);
+    gpio_set_dir(sda, GPIO_IN);
+    gpio_set_dir(scl, GPIO_IN);
+    for (int i = 0; i < 9 && !gpio_get(sda); i++)
+    {
+        gpio_set_dir(scl, GPIO_OUT);
+        busy_wait_us_32(half_us);
+        gpio_set_dir(scl, GPIO_IN);
+        busy_wait_us_32(half_us);
+    }
+    // STOP: SCL为高时SDA由低变高
+    gpio_set_dir(scl, GPIO_OUT);
+    gpio_set_dir(sda, GPIO_OUT);
+    busy_wait_us_32(half_us);
+    gpio_set_dir(scl, GPIO_IN);
+    busy_wait_us_32(half_us);
+    gpio_set_dir(sda, GPIO_IN);
+    busy_wait_us_32(half_us);
+
+    i2c_pico_init(index, pico_hz[index]);
+}
+
+i2c_transport_t i2c_pico_transports[I2C_PICO_BUSES] = {
+    {pico_write, pico_read, NULL, pico_recover},
+    {pico_write, pico_read, NULL, pico_recover},
+};
+
+// 初始化一条硬件总线, 返回实际波特率
+uint32_t i2c_pico_init(uint8_t index, uint32_t hz)
+{
+    i2c_inst_t *port = index ? i2c1 : I2C_PORT;
+    uint8_t sda = pico_sda[index];
+    uint32_t actual = i2c_init(port, hz);
+    gpio_set_function(sda, GPIO_FUNC_I2C);     // SDA引脚
+    gpio_set_function(sda + 1, GPIO_FUNC_I2C); // SCL引脚
+    gpio_pull_up(sda);                         // 上拉SDA
+    gpio_pull_up(sda + 1);                     // 上拉SCL
+    pico_hz[index] = hz;
+    i2c_pico_transports[index].ctx = port;
+    return actual;
+}
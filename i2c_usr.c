@@ -1,35 +1,149 @@
+#include <string.h>
+#include "pico/stdlib.h"
 #include "i2c_usr.h"
-#include "hardware/i2c.h"
+#include "trace.h"
 
-// I²C初始化
-void i2c_init_bus()
+static const i2c_transport_t *bus;
+static uint32_t bus_hz = I2C_BUS_HZ;
+static uint8_t dev_addr = I2C_ADDRESS;
+static i2c_stats_t stats;
+
+// 记录一次事务(到STOP为止): 每个地址段含起始/重复起始位, 每字节含ACK位
+// hz为这条总线的时钟, start为事务开始时的time_us_32(), 实测耗时记进跟踪缓冲
+void i2c_account(uint32_t hz, uint32_t addr_phases, size_t len, uint32_t start)
+{
+    uint32_t bits = addr_phases * (1 + 9) + 9 * len + 1;
+    uint32_t took = time_us_32() - start;
+    TRACE(TRACE_I2C, len > 0xFF ? 0xFF : len, took > 0xFFFF ? 0xFFFF : took);
+    stats.transactions++;
+    stats.bytes += addr_phases + len;
+    stats.bus_time_ns += (uint64_t)bits * 1000000000u / hz;
+}
+
+// 选择I²C传输后端
+void i2c_set_transport(const i2c_transport_t *transport, uint32_t hz)
+{
+    bus = transport;
+    bus_hz = hz;
+}
+
+// 选择从机地址, 之后的读写都发往该地址
+void i2c_set_address(uint8_t addr)
+{
+    dev_addr = addr;
+}
+
+void i2c_get_target(i2c_target_t *t)
+{
+    *t = (i2c_target_t){.bus = bus, .bus_hz = bus_hz, .addr = dev_addr};
+}
+
+void i2c_set_target(const i2c_target_t *t)
+{
+    bus = t->bus;
+    bus_hz = t->bus_hz;
+    dev_addr = t->addr;
+}
+
+// 记一次失败: 超时说明总线可能被拉死, 先恢复出错的那条总线再让调用方重试
+void i2c_error(const i2c_transport_t *transport, int result)
+{
+    if (result == I2C_ERR_TIMEOUT)
+    {
+        stats.timeouts++;
+        if (transport->recover)
+        {
+            transport->recover(transport->ctx);
+            stats.recoveries++;
+        }
+    }
+    else
+        stats.nacks++;
+}
+
+// 一次完整事务: 先写wlen字节, rlen非0时重复起始后再读; 失败按I2C_RETRIES重试
+static bool i2c_transfer(const uint8_t *wbuf, size_t wlen, uint8_t *rbuf, size_t rlen)
+{
+    for (uint8_t attempt = 0; attempt <= I2C_RETRIES; attempt++)
+    {
+        if (attempt)
+        {
+            stats.retries++;
+            busy_wait_us_32(I2C_RETRY_DELAY_US);
+        }
+        uint32_t start = time_us_32();
+        int result = bus->write(bus->ctx, dev_addr, wbuf, wlen, rlen != 0);
+        if (result == (int)wlen && rlen)
+        {
+            // 读阶段的错误码原样交给i2c_error(), 超时才会计数并恢复总线; 读少了按NACK算
+            int got = bus->read(bus->ctx, dev_addr, rbuf, rlen, false);
+            result = got == (int)rlen ? (int)wlen : got < 0 ? got : I2C_ERR_NACK;
+        }
+        i2c_account(bus_hz, rlen ? 2 : 1, wlen + rlen, start);
+        if (result == (int)wlen)
+            return true;
+        i2c_error(bus, result);
+    }
+    stats.failures++;
+    return false;
+}
+
+// 当前地址上是否有设备应答(只发地址和寄存器指针)
+// 没有设备时NACK是正常结果, 不重试也不计错; 超时照样恢复总线
+bool i2c_probe()
 {
-    i2c_init(I2C_PORT, 80000);            // 初始化I²C，波特率100kHz
-    gpio_set_function(16, GPIO_FUNC_I2C); // SDA引脚
-    gpio_set_function(17, GPIO_FUNC_I2C); // SCL引脚
-    gpio_pull_up(16);                     // 上拉SDA
-    gpio_pull_up(17);                     // 上拉SCL
+    uint8_t reg = 0x00;
+    uint32_t start = time_us_32();
+    int result = bus->write(bus->ctx, dev_addr, &reg, 1, false);
+    i2c_account(bus_hz, 1, 1, start);
+    if (result == I2C_ERR_TIMEOUT)
+        i2c_error(bus, result);
+    return result == 1;
 }
 
 // I²C写一个字节
-void i2c_write_byte(uint8_t reg, uint8_t data)
+bool i2c_write_byte(uint8_t reg, uint8_t data)
 {
     uint8_t buf[2] = {reg, data};
-    i2c_write_blocking(I2C_PORT, I2C_ADDRESS, buf, 2, false);
+    return i2c_write_raw(buf, 2);
 }
 
-// I²C读一个字节
+// I²C读一个字节, 失败时返回0
 uint8_t i2c_read_byte(uint8_t reg)
 {
-    uint8_t data;
-    i2c_write_blocking(I2C_PORT, I2C_ADDRESS, &reg, 1, true);  // 发送寄存器地址
-    i2c_read_blocking(I2C_PORT, I2C_ADDRESS, &data, 1, false); // 读取数据
+    uint8_t data = 0;
+    if (!i2c_read_bytes(reg, &data, 1))
+        return 0;
     return data;
 }
 
 // I²C读多个字节
-void i2c_read_bytes(uint8_t reg, uint8_t *data, uint8_t size)
+bool i2c_read_bytes(uint8_t reg, uint8_t *data, uint8_t size)
+{
+    return i2c_transfer(&reg, 1, data, size);
+}
+
+// I²C从reg开始连续写多个字节
+bool i2c_write_bytes(uint8_t reg, const uint8_t *data, uint8_t size)
+{
+    uint8_t buf[1 + size];
+    buf[0] = reg;
+    memcpy(&buf[1], data, size);
+    return i2c_write_raw(buf, 1 + size);
+}
+
+// I²C写一段数据(首字节为寄存器地址)
+bool i2c_write_raw(const uint8_t *buf, size_t len)
+{
+    return i2c_transfer(buf, len, NULL, 0);
+}
+
+void i2c_get_stats(i2c_stats_t *out)
+{
+    *out = stats;
+}
+
+void i2c_reset_stats()
 {
-    i2c_write_blocking(I2C_PORT, I2C_ADDRESS, &reg, 1, true);    // 发送寄存器地址
-    i2c_read_blocking(I2C_PORT, I2C_ADDRESS, data, size, false); // 读取数据
+    stats = (i2c_stats_t){0};
 }
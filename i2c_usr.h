@@ -1,15 +1,83 @@
 #ifndef I2C_USR_H
 #define I2C_USR_H
 
-#include <stdio.h>
-#include "pico/stdlib.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
-#define I2C_PORT i2c0
-#define I2C_ADDRESS 0x41
+#define I2C_ADDRESS 0x41 // 上电默认地址
 
-void i2c_init_bus();
-void i2c_write_byte(uint8_t reg, uint8_t data);
+// 总线时钟: TMF8821支持到Fast-mode Plus. 400 kHz以上要外接上拉(1 MHz约2.2k),
+// 板内上拉(50k以上)的上升沿跟不上. 编译时用-DI2C_BUS_HZ=...改
+#define I2C_STANDARD_HZ 100000
+#define I2C_FAST_HZ 400000
+#define I2C_FAST_PLUS_HZ 1000000
+#ifndef I2C_BUS_HZ
+#define I2C_BUS_HZ I2C_FAST_HZ
+#endif
+
+// 出错重试: NACK直接重试, 超时先做总线恢复再重试
+#define I2C_RETRIES 3
+#define I2C_RETRY_DELAY_US 50
+#define I2C_TIMEOUT_BASE_US 1000 // 每次传输的超时 = 此值 + 2倍线上时间
+
+// 传输后端返回的错误码
+#define I2C_ERR_NACK -1    // 地址或数据没有应答
+#define I2C_ERR_TIMEOUT -2 // 超时, 总线可能被拉死
+
+// I²C传输后端: 返回传输的字节数, 出错时返回I2C_ERR_*
+// recover: 总线恢复(切到GPIO打9个SCL时钟、发STOP、重新初始化控制器), 可为NULL
+typedef struct
+{
+    int (*write)(void *ctx, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+    int (*read)(void *ctx, uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+    void *ctx;
+    void (*recover)(void *ctx);
+} i2c_transport_t;
+
+// 总线统计: 事务数、线上字节数(含地址字节)、按时钟估算的总线时间, 以及出错计数
+typedef struct
+{
+    uint32_t transactions;
+    uint32_t bytes;
+    uint64_t bus_time_ns;
+    uint32_t nacks;
+    uint32_t timeouts;
+    uint32_t retries;
+    uint32_t recoveries;
+    uint32_t failures; // 重试用完仍失败的事务
+} i2c_stats_t;
+
+// Pico后端(i2c_pico.c)
+#define I2C_PICO_BUSES 2
+extern i2c_transport_t i2c_pico_transports[I2C_PICO_BUSES];
+uint32_t i2c_pico_init(uint8_t index, uint32_t hz);
+void i2c_set_transport(const i2c_transport_t *transport, uint32_t bus_hz);
+void i2c_set_address(uint8_t addr);
+bool i2c_probe();
+bool i2c_write_byte(uint8_t reg, uint8_t data);
 uint8_t i2c_read_byte(uint8_t reg);
-void i2c_read_bytes(uint8_t reg, uint8_t *data, uint8_t size);
+bool i2c_read_bytes(uint8_t reg, uint8_t *data, uint8_t size);
+bool i2c_write_bytes(uint8_t reg, const uint8_t *data, uint8_t size);
+bool i2c_write_raw(const uint8_t *buf, size_t len);
+
+// 不经i2c_transfer的传输(DMA取帧)也记进统计; i2c_error在超时时恢复给出的总线.
+// 总线和时钟都由调用方给出, 中断里用不必改当前选择
+void i2c_account(uint32_t hz, uint32_t addr_phases, size_t len, uint32_t start);
+void i2c_error(const i2c_transport_t *transport, int result);
+
+// 当前的总线、时钟和从机地址; 中断里临时换从机时先存下, 用完恢复
+typedef struct
+{
+    const i2c_transport_t *bus;
+    uint32_t bus_hz;
+    uint8_t addr;
+} i2c_target_t;
+
+void i2c_get_target(i2c_target_t *t);
+void i2c_set_target(const i2c_target_t *t);
+
+void i2c_get_stats(i2c_stats_t *stats);
+void i2c_reset_stats();
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "log.h"
+
+static const char *const log_formats[LOG_MSGS] = {
+    [LOG_DOWNLOAD_INIT] = "DOWNLOAD_INIT command sent.",
+    [LOG_SET_ADDR] = "SET_ADDR command sent for address 0x%04lX.",
+    [LOG_RAMREMAP_RESET] = "RAMREMAP_RESET command sent.",
+    [LOG_W_RAM_FAILED] = "W_RAM failed at 0x%04lX: %ld",
+    [LOG_BL_CMD_FAILED] = "Bootloader command failed: %ld",
+    [LOG_APP_MISMATCH] = "Loaded app %lu.%lu.%lu differs from image, downloading.",
+    [LOG_NOT_READY] = "Sensor 0x%02lX not ready (%ld), ENABLE 0x%02lX",
+    [LOG_CONFIG_LOADED] = "Common configuration page loaded.",
+    [LOG_CONFIG_APPLIED] = "Sensor 0x%02lX configured: period %lu ms, SPAD map %lu.",
+    [LOG_CONFIG_WRITTEN] = "Common configuration page written.",
+    [LOG_INT_ENABLED] = "Result interrupts enabled.",
+    [LOG_INT_CLEARED] = "Interrupts cleared.",
+    [LOG_MEASURE_STARTED] = "Measurement started.",
+    [LOG_MEASURE_STOPPED] = "Measurement stopped.",
+    [LOG_BAD_CONFIG_PAGE] = "Unexpected configuration page: ID 0x%02lX, size 0x%02lX 0x%02lX",
+    [LOG_SENSOR_FAILED] = "Sensor %lu (0x%02lX) failed to start in state %lu",
+    [LOG_CONFIG_UNCHANGED] = "Sensor 0x%02lX configuration unchanged, not written.",
+    [LOG_WARM_STOP_FAILED] = "Sensor 0x%02lX did not stop (%ld), downloading.",
+};
+
+typedef struct
+{
+    uint32_t window_us;
+    uint8_t count;
+    uint8_t suppressed;
+} log_rate_t;
+
+static log_record_t rings[LOG_CORES][LOG_RECORDS];
+static volatile uint32_t heads[LOG_CORES]; // 只由对应核写
+static volatile uint32_t tails[LOG_CORES]; // 只由读取端写
+static log_rate_t rates[LOG_CORES][LOG_MSGS][LOG_RATE_KEYS];
+static volatile uint32_t lost[LOG_CORES]; // 只由对应核写
+
+// 同一个核上中断和主循环都可能记, 关中断的时间只有写一条记录
+void log_record(uint8_t id, uint32_t a0, uint32_t a1, uint32_t a2)
+{
+    if (id >= LOG_MSGS)
+        return;
+    uint32_t irq = save_and_disable_interrupts();
+    uint core = get_core_num();
+    uint32_t now = time_us_32();
+    log_rate_t *rate = &rates[core][id][a0 & (LOG_RATE_KEYS - 1)];
+    if (now - rate->window_us >= LOG_RATE_WINDOW_US)
+    {
+        rate->window_us = now;
+        rate->count = 0;
+    }
+    uint32_t head = heads[core];
+    if (rate->count >= LOG_RATE_MAX)
+    {
+        if (rate->suppressed < 0xFF)
+            rate->suppressed++;
+    }
+    else if (head - tails[core] >= LOG_RECORDS)
+        lost[core]++;
+    else
+    {
+        log_record_t *r = &rings[core][head & (LOG_RECORDS - 1)];
+        r->t_us = now;
+        r->id = id;
+        r->suppressed = rate->suppressed;
+        r->args[0] = a0;
+        r->args[1] = a1;
+        r->args[2] = a2;
+        rate->count++;
+        rate->suppressed = 0;
+        heads[core] = head + 1;
+    }
+    restore_interrupts(irq);
+}
+
+bool log_take(uint8_t core, log_record_t *out)
+{
+    uint32_t tail = tails[core];
+    if (tail == heads[core])
+        return false;
+    *out = rings[core][tail & (LOG_RECORDS - 1)];
+    tails[core] = tail + 1;
+    return true;
+}
+
+// 参数按有符号32位扩展成long, 负的状态码用%ld, 其余都是非负值;
+// 未知的消息号(主机和固件的表不一致)只打号和参数
+int log_format(const log_record_t *r, char *buf, size_t len)
+{
+    const char *fmt = r->id < LOG_MSGS ? log_formats[r->id] : NULL;
+    int n = snprintf(buf, len, "[%lu.%03lu] ", (unsigned long)(r->t_us / 1000000),
+                     (unsigned long)(r->t_us / 1000 % 1000));
+    if (n < 0 || (size_t)n >= len)
+        return n;
+    long a0 = (int32_t)r->args[0], a1 = (int32_t)r->args[1], a2 = (int32_t)r->args[2];
+    int m = fmt ? snprintf(buf + n, len - n, fmt, a0, a1, a2)
+                : snprintf(buf + n, len - n, "log %u: %ld %ld %ld", r->id, a0, a1, a2);
+    if (m < 0)
+        return m;
+    n += m;
+    if (r->suppressed && (size_t)n < len)
+        n += snprintf(buf + n, len - n, " (+%u suppressed)", r->suppressed);
+    return n;
+}
+
+uint32_t log_drain(uint32_t max)
+{
+    char line[128];
+    log_record_t r;
+    uint32_t n = 0;
+    for (uint8_t core = 0; core < LOG_CORES; core++)
+        while (n < max && log_take(core, &r))
+        {
+            log_format(&r, line, sizeof(line));
+            printf("%s\n", line);
+            n++;
+        }
+    return n;
+}
+
+uint32_t log_lost(void)
+{
+    uint32_t n = 0;
+    for (uint8_t core = 0; core < LOG_CORES; core++)
+        n += lost[core];
+    return n;
+}
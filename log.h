@@ -0,0 +1,94 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// 延迟日志: 调用处只把消息号和最多3个整数参数连同µs时间戳写进内存环(每个核一个),
+// 不格式化、不碰USB. 主循环里log_drain()按消息表格式化输出, 或取原始记录打包发给主机.
+// 低于LOG_LEVEL的调用在编译时去掉; 每个消息号按第一个参数(多为传感器地址或序号)的低位分开限流,
+// 每份每个窗口最多记LOG_RATE_MAX条, 超出的只计数, 附在下一条记下的同份记录上.
+// 低位相同的参数共用一份. 环满时丢新记录并计数
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+#define LOG_CORES 2
+#define LOG_RECORDS 128 // 每核, 必须是2的幂
+#define LOG_ARGS 3
+#define LOG_RATE_WINDOW_US 1000000
+#define LOG_RATE_MAX 4
+#define LOG_RATE_KEYS 8 // 每个消息号的限流份数, 必须是2的幂
+
+// 消息号, 格式串在log.c的log_formats[]里, 参数按long格式化
+#define LOG_DOWNLOAD_INIT 1
+#define LOG_SET_ADDR 2           // 地址
+#define LOG_RAMREMAP_RESET 3
+#define LOG_W_RAM_FAILED 4       // 地址, 状态
+#define LOG_BL_CMD_FAILED 5      // 状态
+#define LOG_APP_MISMATCH 6       // 主版本, 次版本, 补丁
+#define LOG_NOT_READY 7          // 传感器地址, 结果, ENABLE
+#define LOG_CONFIG_LOADED 8
+#define LOG_CONFIG_APPLIED 9     // 传感器地址, 测量周期ms, SPAD图
+// 10, 11 已废弃, 不要复用
+#define LOG_CONFIG_WRITTEN 12
+#define LOG_INT_ENABLED 13
+#define LOG_INT_CLEARED 14
+#define LOG_MEASURE_STARTED 15
+#define LOG_MEASURE_STOPPED 16
+// 17, 18 已废弃, 不要复用
+#define LOG_BAD_CONFIG_PAGE 19   // 页ID, 大小低字节, 高字节
+#define LOG_SENSOR_FAILED 20     // 传感器序号, 地址, 失败时的状态
+#define LOG_CONFIG_UNCHANGED 21  // 传感器地址
+#define LOG_WARM_STOP_FAILED 22  // 传感器地址, 结果
+#define LOG_MSGS 23
+
+typedef struct
+{
+    uint32_t t_us;
+    uint8_t id;
+    uint8_t suppressed; // 这条之前被限速丢掉的同号记录(封顶255)
+    uint32_t args[LOG_ARGS];
+} log_record_t;
+
+#define LOG_RECORD_(id, a0, a1, a2, ...) log_record((id), (uint32_t)(a0), (uint32_t)(a1), (uint32_t)(a2))
+#define LOG_EMIT_(...) LOG_RECORD_(__VA_ARGS__, 0, 0, 0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(...) LOG_EMIT_(__VA_ARGS__)
+#else
+#define LOG_E(...) ((void)0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(...) LOG_EMIT_(__VA_ARGS__)
+#else
+#define LOG_W(...) ((void)0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(...) LOG_EMIT_(__VA_ARGS__)
+#else
+#define LOG_I(...) ((void)0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(...) LOG_EMIT_(__VA_ARGS__)
+#else
+#define LOG_D(...) ((void)0)
+#endif
+
+// 可在中断里调用, 直接用LOG_E/W/I/D
+void log_record(uint8_t id, uint32_t a0, uint32_t a1, uint32_t a2);
+
+// 读取端, 只在一个核上调用: 按核取出最旧的记录, 没有时返回false
+bool log_take(uint8_t core, log_record_t *out);
+// 格式化一条记录(不带换行), 返回写入的字符数
+int log_format(const log_record_t *r, char *buf, size_t len);
+// 格式化最多max条输出到stdout, 返回输出的条数
+uint32_t log_drain(uint32_t max);
+// 环满丢掉的记录数, 各核合计
+uint32_t log_lost(void);
+
+#endif
@@ -0,0 +1,96 @@
+#include "point_cloud.h"
+
+// 区中心在成像面上等间距排列, 第i列中心的正切为 t*(2i+1-n)/n, t为半视场角的正切;
+// 方向 = (tx, ty, 1)/sqrt(1+tx²+ty²). 整个表达式是常量表达式, 1/sqrt用二阶展开作初值
+// 再迭代两次牛顿法(视场内误差远小于Q14的一个单位), 编译时就算成整数, 运行时不碰浮点
+#define DIR_TAN(t, n, i) ((t) * (2.0 * (i) + 1.0 - (n)) / (n))
+#define DIR_NORM2(tx, ty) (1.0 + (tx) * (tx) + (ty) * (ty))
+#define DIR_RSQRT_SEED(r) (1.0 - ((r) - 1.0) / 2 + 3.0 * ((r) - 1.0) * ((r) - 1.0) / 8)
+#define DIR_RSQRT_STEP(r, y) ((y) * (1.5 - 0.5 * (r) * (y) * (y)))
+#define DIR_RSQRT(r) DIR_RSQRT_STEP(r, DIR_RSQRT_STEP(r, DIR_RSQRT_SEED(r)))
+#define DIR_Q14(v) ((int16_t)((v) * POINT_DIR_ONE + ((v) < 0 ? -0.5 : 0.5)))
+#define DIR_OF(tx, ty)                                                                                                 \
+    {DIR_Q14((tx) * DIR_RSQRT(DIR_NORM2(tx, ty))), DIR_Q14((ty) * DIR_RSQRT(DIR_NORM2(tx, ty))),                     \
+     DIR_Q14(DIR_RSQRT(DIR_NORM2(tx, ty)))}
+#define DIR(tan_x, tan_y, rows, cols, r, c) DIR_OF(DIR_TAN(tan_x, cols, c), DIR_TAN(tan_y, rows, r))
+#define DIR_ROW3(tx, ty, rows, r) DIR(tx, ty, rows, 3, r, 0), DIR(tx, ty, rows, 3, r, 1), DIR(tx, ty, rows, 3, r, 2)
+#define DIR_ROW4(tx, ty, rows, r) DIR(tx, ty, rows, 4, r, 0), DIR(tx, ty, rows, 4, r, 1), DIR(tx, ty, rows, 4, r, 2), \
+                                  DIR(tx, ty, rows, 4, r, 3)
+#define DIR_ROW6(tx, ty, rows, r) DIR(tx, ty, rows, 6, r, 0), DIR(tx, ty, rows, 6, r, 1), DIR(tx, ty, rows, 6, r, 2), \
+                                  DIR(tx, ty, rows, 6, r, 3), DIR(tx, ty, rows, 6, r, 4), DIR(tx, ty, rows, 6, r, 5)
+
+// 各图的视场(水平×垂直)取数据手册的标称值, 表里是半视场角的正切; 换外壳窗口或镜头时改这里
+#define TAN_3X3_X 0.2962 // 33°
+#define TAN_3X3_Y 0.2867 // 32°
+#define TAN_WIDE_X 0.4877 // 52°
+#define TAN_WIDE_Y 0.3739 // 41°
+#define TAN_3X6_Y 0.2962 // 33°
+
+static const point_dir_t dirs_3x3[9] = {
+    DIR_ROW3(TAN_3X3_X, TAN_3X3_Y, 3, 0),
+    DIR_ROW3(TAN_3X3_X, TAN_3X3_Y, 3, 1),
+    DIR_ROW3(TAN_3X3_X, TAN_3X3_Y, 3, 2),
+};
+static const point_dir_t dirs_3x3_wide[9] = {
+    DIR_ROW3(TAN_WIDE_X, TAN_WIDE_Y, 3, 0),
+    DIR_ROW3(TAN_WIDE_X, TAN_WIDE_Y, 3, 1),
+    DIR_ROW3(TAN_WIDE_X, TAN_WIDE_Y, 3, 2),
+};
+static const point_dir_t dirs_4x4[16] = {
+    DIR_ROW4(TAN_WIDE_X, TAN_WIDE_Y, 4, 0),
+    DIR_ROW4(TAN_WIDE_X, TAN_WIDE_Y, 4, 1),
+    DIR_ROW4(TAN_WIDE_X, TAN_WIDE_Y, 4, 2),
+    DIR_ROW4(TAN_WIDE_X, TAN_WIDE_Y, 4, 3),
+};
+static const point_dir_t dirs_3x6[18] = {
+    DIR_ROW6(TAN_WIDE_X, TAN_3X6_Y, 3, 0),
+    DIR_ROW6(TAN_WIDE_X, TAN_3X6_Y, 3, 1),
+    DIR_ROW6(TAN_WIDE_X, TAN_3X6_Y, 3, 2),
+};
+
+// 近距(macro)图和普通3x3的视场相同
+const point_dir_t *point_cloud_dirs(uint8_t spad_map_id)
+{
+    switch (spad_map_id)
+    {
+    case SPAD_MAP_3X3_WIDE:
+        return dirs_3x3_wide;
+    case SPAD_MAP_4X4_NORMAL:
+        return dirs_4x4;
+    case SPAD_MAP_3X6:
+        return dirs_3x6;
+    default:
+        return dirs_3x3;
+    }
+}
+
+// 距离≤65535、方向≤16384, 乘积在int32内; 加半个单位后右移取整.
+// 传感器量程不过几米, 坐标放得进int16
+uint8_t point_cloud_convert(const depth_frame_t *frame, point_t *points)
+{
+    const tmf8821_spad_map_t *map = tmf8821_find_spad_map(frame->spad_map_id);
+    const point_dir_t *dirs = point_cloud_dirs(frame->spad_map_id);
+    uint8_t zones = frame->rows * frame->cols;
+    uint8_t n = 0;
+
+    if (frame->rows != map->rows || frame->cols != map->cols) // 方向表按图的区数排列
+        return 0;
+    for (uint8_t z = 0; z < zones; z++)
+    {
+        const point_dir_t *d = &dirs[z];
+        for (int o = 0; o < RESULT_OBJECTS; o++)
+        {
+            const tmf8821_object_t *obj = &frame->zones[o][z];
+            if (obj->confidence == 0)
+                continue;
+            int32_t dist = obj->distance_mm;
+            point_t *p = &points[n++];
+            p->x = (int16_t)((dist * d->x + POINT_DIR_ONE / 2) >> 14);
+            p->y = (int16_t)((dist * d->y + POINT_DIR_ONE / 2) >> 14);
+            p->z = (int16_t)((dist * d->z + POINT_DIR_ONE / 2) >> 14);
+            p->zone = z;
+            p->confidence = obj->confidence;
+        }
+    }
+    return n;
+}
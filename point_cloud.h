@@ -0,0 +1,34 @@
+#ifndef POINT_CLOUD_H
+#define POINT_CLOUD_H
+
+#include "depth_frame.h"
+
+// 深度图转三维点: 每个SPAD图有一张编译时算好的区方向表(Q14单位向量),
+// 每个有效目标(置信度非0)的距离乘上所在区的方向得到一个点, 全程整数运算.
+// 坐标以传感器为原点, 单位mm: x向右(列增大), y向下(行增大), z沿光轴向前;
+// 距离按沿视线的径向距离处理
+#define POINT_CLOUD_MAX (RESULT_OBJECTS * TMF8821_ZONES_MAX)
+#define POINT_DIR_ONE 16384 // Q14的1.0
+
+typedef struct
+{
+    int16_t x;
+    int16_t y;
+    int16_t z;
+} point_dir_t;
+
+typedef struct
+{
+    int16_t x;
+    int16_t y;
+    int16_t z;
+    uint8_t zone;
+    uint8_t confidence;
+} point_t;
+
+// 按SPAD图取方向表(rows×cols项, 行优先), 表里没有的图按3x3处理, 与tmf8821_find_spad_map一致
+const point_dir_t *point_cloud_dirs(uint8_t spad_map_id);
+// 把一幅的有效目标转成点, 按区号、同区内第一目标在前, 返回点数(最多POINT_CLOUD_MAX)
+uint8_t point_cloud_convert(const depth_frame_t *frame, point_t *points);
+
+#endif
@@ -0,0 +1,313 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "sensor_array.h"
+#include "log.h"
+
+void sensor_array_init(sensor_array_t *a, tmf8821_dev_t *devs, uint8_t count)
+{
+    memset(a, 0, sizeof(*a));
+    a->devs = devs;
+    a->count = count > SENSOR_MAX ? SENSOR_MAX : count;
+    for (uint8_t i = 0; i < a->count; i++)
+    {
+        gpio_init(devs[i].pin_en);
+        gpio_put(devs[i].pin_en, 1); // 先置高再设为输出, 不让传感器掉电
+        gpio_set_dir(devs[i].pin_en, GPIO_OUT);
+        gpio_init(devs[i].pin_int);
+        gpio_set_dir(devs[i].pin_int, GPIO_IN);
+    }
+}
+
+// 同一总线上同一时间只能有一个传感器在默认地址上; 工作地址就是默认地址的那个最后上电
+static bool may_power_on(sensor_array_t *a, uint8_t i)
+{
+    for (uint8_t j = 0; j < a->count; j++)
+    {
+        if (j == i || a->devs[j].bus != a->devs[i].bus || a->state[j] == SENSOR_FAILED)
+            continue;
+        if (a->devs[i].addr == I2C_ADDRESS && a->state[j] != SENSOR_READY)
+            return false;
+        if (a->state[j] != SENSOR_OFF && a->cur_addr[j] == I2C_ADDRESS)
+            return false;
+    }
+    return true;
+}
+
+// 同一总线上已有就绪的传感器用着这个地址
+static bool addr_conflict(sensor_array_t *a, uint8_t i)
+{
+    for (uint8_t j = 0; j < a->count; j++)
+    {
+        if (j != i && a->devs[j].bus == a->devs[i].bus && a->state[j] == SENSOR_READY &&
+            a->devs[j].addr == a->devs[i].addr)
+            return true;
+    }
+    return false;
+}
+
+static void select_current(sensor_array_t *a, uint8_t i)
+{
+    tmf8821_select(&a->devs[i]);
+    i2c_set_address(a->cur_addr[i]);
+}
+
+// 推进一个传感器的启动, 每次只做一小步(一次状态读或一条命令), 不等待
+static void bringup_step(sensor_array_t *a, uint8_t i, const uint8_t *image, uint32_t length,
+                         const uint8_t version[3])
+{
+    tmf8821_dev_t *d = &a->devs[i];
+    uint8_t before = a->state[i];
+    int status;
+
+    switch (a->state[i])
+    {
+    case SENSOR_OFF:
+        if (addr_conflict(a, i))
+        {
+            a->state[i] = SENSOR_FAILED;
+            break;
+        }
+        if (!may_power_on(a, i))
+            break; // 等同一总线上前一个改完地址
+        gpio_put(d->pin_en, 1);
+        a->cur_addr[i] = I2C_ADDRESS;
+        a->state[i] = SENSOR_WAKING;
+        a->deadline_us[i] = time_us_64() + SENSOR_WAKE_TIMEOUT_US;
+        break;
+    case SENSOR_WAKING:
+        select_current(a, i);
+        if (i2c_probe())
+        { // 刚上电时是待机状态, 由驱动置PON并等CPU就绪; 唤醒超时就从头再来, 直到deadline
+            status = d->power.waking ? tmf8821_wake_poll() : tmf8821_wake_begin();
+            if (status == TMF8821_OK)
+            {
+                d->power.awaiting_frame = false; // 上电不算从待机恢复, 不记首帧耗时
+                status = tmf8821_boot_begin(image, length, version);
+                a->state[i] = status == TMF8821_OK        ? SENSOR_READDRESS
+                              : status == TMF8821_PENDING ? SENSOR_BOOTING
+                                                          : SENSOR_FAILED;
+                break;
+            }
+        }
+        if (time_us_64() >= a->deadline_us[i])
+            a->state[i] = SENSOR_FAILED;
+        break;
+    case SENSOR_BOOTING:
+        select_current(a, i);
+        status = tmf8821_boot_poll();
+        if (status == TMF8821_OK)
+            a->state[i] = SENSOR_READDRESS;
+        else if (status != TMF8821_PENDING)
+            a->state[i] = SENSOR_FAILED;
+        break;
+    case SENSOR_READDRESS:
+        select_current(a, i);
+        status = TMF8821_OK;
+        if (a->cur_addr[i] != d->addr)
+            status = tmf8821_set_i2c_address(d->addr);
+        if (status == TMF8821_OK)
+        {
+            a->cur_addr[i] = d->addr;
+            a->state[i] = SENSOR_READY;
+        }
+        else
+            a->state[i] = SENSOR_FAILED;
+        break;
+    default:
+        break;
+    }
+
+    if (a->state[i] == SENSOR_FAILED && before != SENSOR_FAILED)
+    {
+        LOG_W(LOG_SENSOR_FAILED, i, d->addr, before);
+        gpio_put(d->pin_en, 0); // 让出默认地址
+    }
+}
+
+// 启动全部传感器, 返回就绪的个数
+// 各传感器都已在工作地址上应答时(仅MCU复位)不掉电, 由tmf8821_boot_begin()热启动
+int sensor_array_bringup(sensor_array_t *a, const uint8_t *image, uint32_t length, const uint8_t version[3])
+{
+    uint64_t start = time_us_64();
+    bool warm = true;
+
+    for (uint8_t i = 0; i < a->count; i++)
+    {
+        tmf8821_select(&a->devs[i]);
+        warm = warm && i2c_probe();
+    }
+    for (uint8_t i = 0; i < a->count; i++)
+    {
+        a->cur_addr[i] = warm ? a->devs[i].addr : I2C_ADDRESS;
+        a->state[i] = warm ? SENSOR_WAKING : SENSOR_OFF;
+        a->deadline_us[i] = start + SENSOR_WAKE_TIMEOUT_US;
+        if (!warm)
+            gpio_put(a->devs[i].pin_en, 0);
+    }
+    // 同一总线上工作地址重复的只启动第一个: 都用默认地址时两个会互相等对方就绪, 永远起不来
+    for (uint8_t i = 0; i < a->count; i++)
+    {
+        for (uint8_t j = 0; j < i; j++)
+        {
+            if (a->devs[j].bus == a->devs[i].bus && a->devs[j].addr == a->devs[i].addr &&
+                a->state[j] != SENSOR_FAILED)
+            {
+                LOG_W(LOG_SENSOR_FAILED, i, a->devs[i].addr, a->state[i]);
+                a->state[i] = SENSOR_FAILED;
+                gpio_put(a->devs[i].pin_en, 0);
+                break;
+            }
+        }
+    }
+    if (!warm)
+        sleep_us(SENSOR_EN_LOW_US);
+
+    // 轮流推进各传感器; 不同总线上的下载交替进行, 传输本身不并行(见sensor_array.h)
+    uint8_t pending;
+    do
+    {
+        pending = 0;
+        for (uint8_t i = 0; i < a->count; i++)
+        {
+            bringup_step(a, i, image, length, version);
+            pending += a->state[i] < SENSOR_READY;
+        }
+    } while (pending);
+
+    int ready = 0;
+    for (uint8_t i = 0; i < a->count; i++)
+        ready += a->state[i] == SENSOR_READY;
+    a->bringup_us = time_us_64() - start;
+    return ready;
+}
+
+// 在每个就绪的传感器上写入同一测量配置并打开中断, 返回第一个错误;
+// 写配置失败的传感器不开中断, 标为失败, 之后不再参与测量
+int sensor_array_configure(sensor_array_t *a, const tmf8821_config_t *config)
+{
+    int result = TMF8821_OK;
+    a->spad_map_id = config->spad_map_id;
+    for (uint8_t i = 0; i < a->count; i++)
+    {
+        if (a->state[i] != SENSOR_READY)
+            continue;
+        tmf8821_select(&a->devs[i]);
+        int status = tmf8821_apply_config(config);
+        if (status != TMF8821_OK)
+        {
+            if (result == TMF8821_OK)
+                result = status;
+            LOG_W(LOG_SENSOR_FAILED, i, a->devs[i].addr, a->state[i]);
+            a->state[i] = SENSOR_FAILED;
+            continue;
+        }
+        enable_interrupts();
+        clear_interrupts();
+    }
+    return result;
+}
+
+// 依次启动测量, 起点在一个周期内均匀错开, 各传感器的结果读取不挤在一起;
+// resume时从待机恢复(不打印), 返回启动成功的个数.
+// 调用时中断已关, 之后读到的帧都带新的批次号
+static int start_staggered(sensor_array_t *a, uint16_t period_ms, bool resume)
+{
+    uint8_t ready = 0, k = 0;
+    int started = 0;
+    for (uint8_t i = 0; i < a->count; i++)
+        ready += a->state[i] == SENSOR_READY;
+    if (ready == 0)
+        return 0;
+    a->run++;
+
+    uint32_t slot_us = period_ms * 1000u / ready;
+    uint64_t t0 = time_us_64();
+    for (uint8_t i = 0; i < a->count; i++)
+    {
+        if (a->state[i] != SENSOR_READY)
+            continue;
+        uint64_t at = t0 + (uint64_t)slot_us * k++;
+        uint64_t now = time_us_64();
+        if (at > now)
+            sleep_us(at - now);
+        tmf8821_select(&a->devs[i]);
+        if (resume)
+            started += tmf8821_resume() == TMF8821_OK;
+        else
+        {
+            clear_interrupts();
+            started += start_measurement() == TMF8821_OK;
+        }
+    }
+    return started;
+}
+
+void sensor_array_start(sensor_array_t *a, uint16_t period_ms)
+{
+    start_staggered(a, period_ms, false);
+}
+
+void sensor_array_stop(sensor_array_t *a)
+{
+    for (uint8_t i = 0; i < a->count; i++)
+    {
+        if (a->state[i] != SENSOR_READY)
+            continue;
+        tmf8821_select(&a->devs[i]);
+        stop_measurement();
+    }
+}
+
+// 停测量并进入待机, 返回进入待机的个数
+int sensor_array_standby(sensor_array_t *a)
+{
+    int count = 0;
+    for (uint8_t i = 0; i < a->count; i++)
+    {
+        if (a->state[i] != SENSOR_READY)
+            continue;
+        tmf8821_select(&a->devs[i]);
+        count += tmf8821_standby() == TMF8821_OK;
+    }
+    return count;
+}
+
+// 从待机恢复: 先给所有传感器置PON, 各自的唤醒时间互相重叠, 再错开发MEASURE;
+// 返回恢复测量的个数
+int sensor_array_resume(sensor_array_t *a, uint16_t period_ms)
+{
+    int status[SENSOR_MAX];
+    bool pending;
+    for (uint8_t i = 0; i < a->count; i++)
+    {
+        status[i] = TMF8821_OK;
+        if (a->state[i] != SENSOR_READY)
+            continue;
+        tmf8821_select(&a->devs[i]);
+        status[i] = tmf8821_wake_begin();
+    }
+    do
+    {
+        pending = false;
+        for (uint8_t i = 0; i < a->count; i++)
+        {
+            if (status[i] != TMF8821_PENDING)
+                continue;
+            tmf8821_select(&a->devs[i]);
+            status[i] = tmf8821_wake_poll();
+            pending |= status[i] == TMF8821_PENDING;
+        }
+    } while (pending);
+    return start_staggered(a, period_ms, true);
+}
+
+// 按INT引脚找传感器序号, 没有返回-1
+int sensor_array_find_int(sensor_array_t *a, uint8_t pin)
+{
+    for (uint8_t i = 0; i < a->count; i++)
+    {
+        if (a->devs[i].pin_int == pin)
+            return i;
+    }
+    return -1;
+}
@@ -0,0 +1,43 @@
+#ifndef SENSOR_ARRAY_H
+#define SENSOR_ARRAY_H
+
+#include "tmf8821.h"
+
+// 多传感器: 一到两条I²C总线上挂多个TMF8821, 各有EN/INT引脚
+// 上电时都在默认地址, 同一总线上借EN脚逐个上电、下载固件并改到各自的工作地址;
+// 不同总线上的下载轮流推进: I²C传输仍在CPU上阻塞进行, 只有引导程序处理各块的等待时间能和另一条
+// 总线的传输叠在一起, 启动时间基本随下载的总字节数增长. 测量起点按周期错开, 各传感器的中断不扎堆
+#define SENSOR_MAX 4
+#define SENSOR_EN_LOW_US 1000      // EN拉低后保持多久才算掉电
+#define SENSOR_WAKE_TIMEOUT_US 100000
+
+// 启动时每个传感器的状态
+#define SENSOR_OFF 0
+#define SENSOR_WAKING 1
+#define SENSOR_BOOTING 2
+#define SENSOR_READDRESS 3
+#define SENSOR_READY 4
+#define SENSOR_FAILED 5
+
+typedef struct
+{
+    tmf8821_dev_t *devs;
+    uint8_t count;
+    uint8_t state[SENSOR_MAX];
+    uint8_t cur_addr[SENSOR_MAX]; // 启动过程中当前应答的地址
+    uint64_t deadline_us[SENSOR_MAX];
+    uint32_t bringup_us;
+    uint8_t run;                  // 每次开始或恢复测量加1, 中断里记进帧槽
+    uint8_t spad_map_id;          // 最近一次写入的配置的SPAD图
+} sensor_array_t;
+
+void sensor_array_init(sensor_array_t *a, tmf8821_dev_t *devs, uint8_t count);
+int sensor_array_bringup(sensor_array_t *a, const uint8_t *image, uint32_t length, const uint8_t version[3]);
+int sensor_array_configure(sensor_array_t *a, const tmf8821_config_t *config);
+void sensor_array_start(sensor_array_t *a, uint16_t period_ms);
+void sensor_array_stop(sensor_array_t *a);
+int sensor_array_standby(sensor_array_t *a);
+int sensor_array_resume(sensor_array_t *a, uint16_t period_ms);
+int sensor_array_find_int(sensor_array_t *a, uint8_t pin);
+
+#endif
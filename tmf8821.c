@@ -1,6 +1,26 @@
+#include <string.h>
+#include "pico/stdlib.h"
 #include "tmf8821.h"
-#include "hardware/i2c.h"
 #include "i2c_usr.h"
+#include "trace.h"
+#include "log.h"
+
+// 未调用tmf8821_select()时的单传感器上下文
+static tmf8821_dev_t default_dev = {.addr = I2C_ADDRESS};
+static tmf8821_dev_t *dev = &default_dev;
+
+// 下载阶段
+#define DL_IDLE 0
+#define DL_INIT 1
+#define DL_ADDR 2
+#define DL_DATA 3
+#define DL_REMAP 4
+#define BL_BUSY 0x100 // 引导程序命令仍在执行
+
+// 固件各块的W_RAM校验和, 所有传感器共用同一映像
+static const uint8_t *csum_image;
+static uint32_t csum_length;
+static uint8_t csum[FW_MAX_CHUNKS];
 
 // 计算校验
 uint8_t calculate_checksum(uint8_t cmd_stat, uint8_t size, uint8_t *data, uint8_t data_length)
@@ -14,7 +34,7 @@ uint8_t calculate_checksum(uint8_t cmd_stat, uint8_t size, uint8_t *data, uint8_
 }
 
 // 下载初始化
-void download_init()
+bool download_init()
 {
     uint8_t cmd_stat = 0x14; // DOWNLOAD_INIT命令
     uint8_t size = 0x01;
@@ -22,13 +42,15 @@ void download_init()
     uint8_t checksum = calculate_checksum(cmd_stat, size, &data, 1);
 
     uint8_t buf[5] = {CMD_STAT_REG, cmd_stat, size, data, checksum};
-    i2c_write_blocking(I2C_PORT, I2C_ADDRESS, buf, 5, false);
+    if (!i2c_write_raw(buf, 5))
+        return false;
 
-    printf("DOWNLOAD_INIT command sent.\n");
+    LOG_D(LOG_DOWNLOAD_INIT);
+    return true;
 }
 
 // 设置目标地址
-void set_address(uint16_t address)
+bool set_address(uint16_t address)
 {
     uint8_t cmd_stat = 0x43; // SET_ADDR命令
     uint8_t size = 0x02;
@@ -36,217 +58,832 @@ void set_address(uint16_t address)
     uint8_t checksum = calculate_checksum(cmd_stat, size, data, 2);
 
     uint8_t buf[6] = {CMD_STAT_REG, cmd_stat, size, data[0], data[1], checksum};
-    i2c_write_blocking(I2C_PORT, I2C_ADDRESS, buf, 6, false);
+    if (!i2c_write_raw(buf, 6))
+        return false;
 
-    printf("SET_ADDR command sent for address 0x%04X.\n", address);
+    LOG_D(LOG_SET_ADDR, address);
+    return true;
 }
 
-// 写入RAM数据
-void write_ram(uint8_t *data, uint8_t data_length)
+// 写入一个W_RAM数据块(校验和已算好)
+static bool write_ram_chunk(const uint8_t *data, uint8_t data_length, uint8_t checksum)
 {
-    uint8_t cmd_stat = 0x41; // W_RAM命令
-    uint8_t size = data_length;
-    uint8_t checksum = calculate_checksum(cmd_stat, size, data, data_length);
-
-    uint8_t buf[4 + data_length];
+    uint8_t buf[4 + FW_CHUNK_MAX];
     buf[0] = CMD_STAT_REG;
-    buf[1] = cmd_stat;
-    buf[2] = size;
-    for (int i = 0; i < data_length; i++)
-    {
-        buf[3 + i] = data[i];
-    }
+    buf[1] = 0x41; // W_RAM命令
+    buf[2] = data_length;
+    memcpy(&buf[3], data, data_length);
     buf[3 + data_length] = checksum;
-    i2c_write_blocking(I2C_PORT, I2C_ADDRESS, buf, 3 + data_length + 1, false);
+    return i2c_write_raw(buf, 3 + data_length + 1);
 }
 
 // 完成下载并重启设备
-void ram_remap_reset()
+bool ram_remap_reset()
 {
     uint8_t cmd_stat = 0x11; // RAMREMAP_RESET命令
     uint8_t size = 0x00;
     uint8_t checksum = calculate_checksum(cmd_stat, size, NULL, 0);
 
     uint8_t buf[4] = {CMD_STAT_REG, cmd_stat, size, checksum};
-    i2c_write_blocking(I2C_PORT, I2C_ADDRESS, buf, 4, false);
+    if (!i2c_write_raw(buf, 4))
+        return false;
 
-    printf("RAMREMAP_RESET command sent.\n");
+    LOG_D(LOG_RAMREMAP_RESET);
+    return true;
 }
 
-// 检查设备是否准备好通信
-void check_device_ready()
+// 读一次引导程序命令状态, 完成时返回状态字节(0为成功), 执行中或没读到返回BL_BUSY
+static int bl_poll()
 {
-    uint8_t enable_value;
+    uint8_t data[3];
+    if (!i2c_read_bytes(CMD_STAT_REG, data, 3))
+        return BL_BUSY;
+    // 命令执行中时这里仍是写入的命令字节, 应答为 状态(<0x10), 0, ~状态
+    if (data[0] < 0x10 && data[1] == 0x00 && (data[0] ^ data[2]) == 0xFF)
+        return data[0];
+    return BL_BUSY;
+}
 
-    while (1)
-    {
-        enable_value = i2c_read_byte(ENABLE_REG); // 读取ENABLE寄存器的值
-        // 检查设备状态
-        if ((enable_value & 0x41) == 0x41)
-        {
-            // 设备已准备好通信 (bit 6 = 1)
-            printf("Device is ready for communication.\n");
-            printf("ENABLE register value: 0x%02X\n", enable_value);
+static uint32_t download_chunks(uint32_t length)
+{
+    return (length + FW_CHUNK_MAX - 1) / FW_CHUNK_MAX;
+}
 
-            break;
-        }
-        else if ((enable_value & 0x41) == 0x01)
+// 开始下载: 算好各块校验和并发出DOWNLOAD_INIT
+static int download_begin(const uint8_t *image, uint32_t length, uint64_t start_us)
+{
+    tmf8821_download_t *dl = &dev->download;
+    uint32_t chunks = download_chunks(length);
+
+    tmf8821_shadow_invalidate();
+    if (chunks > FW_MAX_CHUNKS)
+        return TMF8821_ERR_SIZE;
+    if (csum_image != image || csum_length != length)
+    {
+        for (uint32_t i = 0; i < chunks; i++)
         {
-            // CPU正在初始化 (bit 6 = 0, bit 1 = 1)
-            printf("CPU is initializing. Polling until ready...\n");
-            sleep_ms(10); // 等待10ms
+            uint32_t off = i * FW_CHUNK_MAX;
+            uint8_t n = length - off < FW_CHUNK_MAX ? length - off : FW_CHUNK_MAX;
+            csum[i] = calculate_checksum(0x41, n, (uint8_t *)image + off, n);
         }
-        else if ((enable_value & 0x06) == 0x02)
+        csum_image = image;
+        csum_length = length;
+    }
+
+    dl->image = image;
+    dl->length = length;
+    dl->chunk = 0;
+    dl->start_us = start_us;
+    if (!download_init())
+        return TMF8821_ERR_IO;
+    dl->phase = DL_INIT;
+    dl->deadline_us = time_us_64() + FW_CMD_TIMEOUT_US;
+    return TMF8821_PENDING;
+}
+
+// 推进下载: 读一次状态, 上一条命令完成时发出下一条(SET_ADDR、W_RAM、RAMREMAP_RESET)
+static int download_poll()
+{
+    tmf8821_download_t *dl = &dev->download;
+    int status;
+
+    if (dl->phase == DL_IDLE)
+        return TMF8821_OK;
+    if (dl->phase == DL_REMAP) // 等待应用启动
+        status = i2c_read_byte(APPID_REG) == TMF8821_APPID_MEASURE ? TMF8821_OK : BL_BUSY;
+    else
+        status = bl_poll();
+
+    uint64_t now = time_us_64();
+    if (status == BL_BUSY)
+    {
+        if (now < dl->deadline_us)
+            return TMF8821_PENDING;
+        status = TMF8821_ERR_TIMEOUT;
+    }
+    if (status > 0)
+    { // 引导程序错误状态, 与TMF8821_PENDING区分开
+        if (dl->phase == DL_DATA)
+            LOG_E(LOG_W_RAM_FAILED, (dl->chunk - 1) * FW_CHUNK_MAX, status);
+        else
+            LOG_E(LOG_BL_CMD_FAILED, status);
+        status = TMF8821_ERR_CMD;
+    }
+    if (status != TMF8821_OK || dl->phase == DL_REMAP)
+    {
+        dl->phase = DL_IDLE;
+        return status;
+    }
+
+    // 命令没写进去时CMD_STAT还是上一条的成功状态, 不能接着轮询, 直接放弃
+    bool sent;
+    dl->deadline_us = now + FW_CMD_TIMEOUT_US;
+    if (dl->phase == DL_INIT)
+    {
+        sent = set_address(0x0000);
+        dl->phase = DL_ADDR;
+    }
+    else if (dl->chunk < download_chunks(dl->length))
+    {
+        uint32_t off = dl->chunk * FW_CHUNK_MAX;
+        uint8_t n = dl->length - off < FW_CHUNK_MAX ? dl->length - off : FW_CHUNK_MAX;
+        sent = write_ram_chunk(dl->image + off, n, csum[dl->chunk++]);
+        dl->phase = DL_DATA;
+    }
+    else
+    {
+        sent = ram_remap_reset();
+        dl->phase = DL_REMAP;
+        dl->deadline_us = now + FW_BOOT_TIMEOUT_US;
+    }
+    if (!sent)
+    {
+        dl->phase = DL_IDLE;
+        return TMF8821_ERR_IO;
+    }
+    return TMF8821_PENDING;
+}
+
+// 强制下载固件, 不看传感器里已有的应用(tmf8821_boot()遇到同版本时热启动, 不下载);
+// 传感器须在引导程序里, 即上电或EN复位之后. 与tmf8821_boot()走同一个分步下载, 计为一次冷启动
+int tmf8821_download_firmware(const uint8_t *image, uint32_t length, uint32_t *elapsed_us)
+{
+    uint64_t start = time_us_64();
+    int status = download_begin(image, length, start);
+    while (status == TMF8821_PENDING)
+    {
+        status = tmf8821_boot_poll();
+    }
+    if (status == TMF8821_OK && elapsed_us)
+        *elapsed_us = time_us_64() - start;
+    return status;
+}
+
+// 开始启动应用: 传感器已在运行同版本的测量应用(仅MCU复位)时跳过固件下载, 直接返回TMF8821_OK;
+// 否则开始下载并返回TMF8821_PENDING, 之后反复调用tmf8821_boot_poll()
+int tmf8821_boot_begin(const uint8_t *image, uint32_t length, const uint8_t version[3])
+{
+    uint64_t start = time_us_64();
+    uint8_t rev[3];
+
+    tmf8821_shadow_invalidate(); // 上电或MCU复位后不知道传感器里的配置
+    if (i2c_read_byte(APPID_REG) == TMF8821_APPID_MEASURE)
+    {
+        rev[0] = i2c_read_byte(APPREV_MAJOR_REG);
+        i2c_read_bytes(APPREV_MINOR_REG, &rev[1], 2);
+        if (memcmp(rev, version, 3) == 0)
         {
-            // 设备处于STANDBY模式 (bit 6 = 0, bit 1 = 0, bit 2 = 1)
-            printf("Device is in STANDBY mode. Waking up...\n");
-            uint8_t new_value = (enable_value & 0x30) | 0x01; // 保持bit 5和4，设置bit 0为1
-            i2c_write_byte(ENABLE_REG, new_value);            // 写入新值唤醒设备
-            sleep_ms(10);                                     // 等待10ms
+            // 复位前仍在测量时先停下; 停不下来就不信这个应用, 走冷启动重新下载
+            int result = i2c_read_byte(CMD_STAT_REG) == 0x01 ? stop_measurement() : TMF8821_OK;
+            if (result == TMF8821_OK)
+            {
+                dev->boot.warm_starts++;
+                dev->boot.warm_start_us = time_us_64() - start;
+                return TMF8821_OK;
+            }
+            LOG_W(LOG_WARM_STOP_FAILED, dev->addr, result);
         }
-        else if ((enable_value & 0x06) == 0x06)
+        else
+            LOG_I(LOG_APP_MISMATCH, rev[0], rev[1], rev[2]);
+    }
+    return download_begin(image, length, start);
+}
+
+// 推进下载, 每次最多一条引导程序命令, 不等待; 完成返回TMF8821_OK
+int tmf8821_boot_poll()
+{
+    if (dev->download.phase == DL_IDLE)
+        return TMF8821_OK;
+    int status = download_poll();
+    if (status == TMF8821_OK)
+    {
+        dev->boot.cold_starts++;
+        dev->boot.cold_start_us = time_us_64() - dev->download.start_us;
+    }
+    return status;
+}
+
+// 启动应用并等待完成
+int tmf8821_boot(const uint8_t *image, uint32_t length, const uint8_t version[3])
+{
+    int status = tmf8821_boot_begin(image, length, version);
+    while (status == TMF8821_PENDING)
+    {
+        status = tmf8821_boot_poll();
+    }
+    return status;
+}
+
+void tmf8821_get_boot_stats(tmf8821_boot_stats_t *stats)
+{
+    *stats = dev->boot;
+}
+
+static int power_decode(uint8_t enable)
+{
+    if ((enable & (ENABLE_CPU_READY | ENABLE_PON)) == (ENABLE_CPU_READY | ENABLE_PON))
+        return TMF8821_POWER_READY;
+    if ((enable & (ENABLE_CPU_READY | ENABLE_PON)) == ENABLE_PON)
+        return TMF8821_POWER_INIT;
+    if ((enable & (ENABLE_STANDBY | ENABLE_STANDBY_TIMED)) == ENABLE_STANDBY)
+        return TMF8821_POWER_STANDBY;
+    if ((enable & (ENABLE_STANDBY | ENABLE_STANDBY_TIMED)) == (ENABLE_STANDBY | ENABLE_STANDBY_TIMED))
+        return TMF8821_POWER_STANDBY_TIMED;
+    return TMF8821_POWER_UNKNOWN;
+}
+
+// 读ENABLE得到电源状态, 读不到时为UNKNOWN
+int tmf8821_power_state()
+{
+    uint8_t enable;
+    if (!i2c_read_bytes(ENABLE_REG, &enable, 1))
+        return TMF8821_POWER_UNKNOWN;
+    return power_decode(enable);
+}
+
+// 等设备可以通信: 上电后等CPU就绪, 待机时唤醒; 只在失败时打印
+bool check_device_ready()
+{
+    int result = tmf8821_wake();
+    if (result != TMF8821_OK)
+        LOG_W(LOG_NOT_READY, dev->addr, result, i2c_read_byte(ENABLE_REG));
+    return result == TMF8821_OK;
+}
+
+// 进入待机: 先停测量再清PON. 固件和配置留在RAM里, 唤醒后不用重新下载和配置
+int tmf8821_standby()
+{
+    int result = tmf8821_command(STOP_CMD, TMF8821_CMD_TIMEOUT_US);
+    if (result != TMF8821_OK)
+        return result;
+    uint8_t enable;
+    if (!i2c_read_bytes(ENABLE_REG, &enable, 1) || !i2c_write_byte(ENABLE_REG, enable & ENABLE_POWERUP_SELECT))
+        return TMF8821_ERR_IO;
+    dev->power.standbys++;
+    dev->power.awaiting_frame = false;
+    return TMF8821_OK;
+}
+
+// 开始唤醒: 已就绪返回OK; 待机时置PON(从这时起计唤醒和首帧耗时), 刚上电时只等CPU初始化完;
+// 返回PENDING后用tmf8821_wake_poll()推进
+int tmf8821_wake_begin()
+{
+    tmf8821_power_stats_t *p = &dev->power;
+    uint8_t enable;
+    if (!i2c_read_bytes(ENABLE_REG, &enable, 1))
+        return TMF8821_ERR_IO;
+    switch (power_decode(enable))
+    {
+    case TMF8821_POWER_READY:
+        return TMF8821_OK;
+    case TMF8821_POWER_INIT:
+        break;
+    case TMF8821_POWER_STANDBY:
+    case TMF8821_POWER_STANDBY_TIMED:
+        if (!i2c_write_byte(ENABLE_REG, (enable & ENABLE_POWERUP_SELECT) | ENABLE_PON))
+            return TMF8821_ERR_IO;
+        p->awaiting_frame = true;
+        p->first_frame_us = 0;
+        break;
+    default:
+        return TMF8821_ERR_IO;
+    }
+    p->waking = true;
+    p->wake_start_us = time_us_32();
+    return TMF8821_PENDING;
+}
+
+// 读一次ENABLE, CPU就绪时记下唤醒耗时
+int tmf8821_wake_poll()
+{
+    tmf8821_power_stats_t *p = &dev->power;
+    if (!p->waking)
+        return TMF8821_OK;
+    int state = tmf8821_power_state();
+    uint32_t elapsed = time_us_32() - p->wake_start_us;
+    if (state == TMF8821_POWER_READY)
+    {
+        p->waking = false;
+        p->wakes++;
+        p->wake_us = elapsed;
+        return TMF8821_OK;
+    }
+    if (elapsed >= TMF8821_WAKE_TIMEOUT_US)
+    {
+        p->waking = false;
+        p->awaiting_frame = false;
+        return TMF8821_ERR_TIMEOUT;
+    }
+    return TMF8821_PENDING;
+}
+
+int tmf8821_wake()
+{
+    int result = tmf8821_wake_begin();
+    while (result == TMF8821_PENDING)
+        result = tmf8821_wake_poll();
+    return result;
+}
+
+// 从待机恢复测量: 唤醒后清中断直接发MEASURE, 沿用待机前的固件和配置
+int tmf8821_resume()
+{
+    int result = tmf8821_wake();
+    if (result != TMF8821_OK)
+        return result;
+    if (!i2c_write_byte(INT_CLEAR_REG, 0xFF))
+        return TMF8821_ERR_IO;
+    return tmf8821_command(MEASURE_CMD, TMF8821_CMD_TIMEOUT_US);
+}
+
+// 读到一帧时调用(timestamp_us为INT时间): 唤醒后的第一帧记下首帧耗时
+void tmf8821_power_frame(tmf8821_dev_t *d, uint32_t timestamp_us)
+{
+    tmf8821_power_stats_t *p = &d->power;
+    if (!p->awaiting_frame)
+        return;
+    p->awaiting_frame = false;
+    p->first_frame_us = timestamp_us - p->wake_start_us;
+    if (p->first_frame_us > p->first_frame_max_us)
+        p->first_frame_max_us = p->first_frame_us;
+}
+
+// 异步命令: 每个传感器同一时间只有一条命令在执行, 状态在dev->cmd, 延时统计在dev->cmd_stats
+static tmf8821_cmd_stats_t *cmd_stats_slot(uint8_t cmd)
+{
+    if (cmd >= 0x10 && cmd < 0x10 + TMF8821_CMD_STATS - 1)
+        return &dev->cmd_stats[cmd - 0x10];
+    return &dev->cmd_stats[TMF8821_CMD_STATS - 1];
+}
+
+static void cmd_finish(int result)
+{
+    tmf8821_cmd_stats_t *st = cmd_stats_slot(dev->cmd.cmd);
+    uint32_t latency = time_us_64() - dev->cmd.start_us;
+
+    TRACE(TRACE_CMD_DONE, dev->cmd.cmd, (uint16_t)result);
+    dev->cmd.busy = false;
+    dev->cmd.result = result;
+    dev->cmd.latency_us = latency;
+    st->count++;
+    st->last_us = latency;
+    st->total_us += latency;
+    if (latency > st->max_us)
+        st->max_us = latency;
+    if (result == TMF8821_ERR_TIMEOUT)
+        st->timeouts++;
+    else if (result != TMF8821_OK)
+        st->errors++;
+    if (dev->cmd.cb)
+        dev->cmd.cb(dev->cmd.cmd, result, latency, dev->cmd.user);
+}
+
+// 提交命令, 立即返回; 完成后由tmf8821_cmd_poll()报告或回调
+int tmf8821_cmd_submit(uint8_t cmd, uint32_t timeout_us, tmf8821_cmd_cb cb, void *user)
+{
+    if (dev->cmd.busy)
+        return TMF8821_ERR_BUSY;
+    dev->cmd.cmd = cmd;
+    dev->cmd.cb = cb;
+    dev->cmd.user = user;
+    dev->cmd.busy = true;
+    dev->cmd.start_us = time_us_64();
+    dev->cmd.deadline_us = dev->cmd.start_us + timeout_us;
+    TRACE(TRACE_CMD_SUBMIT, cmd, 0);
+    if (!i2c_write_byte(CMD_STAT_REG, cmd))
+        cmd_finish(TMF8821_ERR_IO);
+    return TMF8821_OK;
+}
+
+// 读一次CMD_STAT推进命令状态: 未完成返回TMF8821_PENDING, 否则返回结果
+int tmf8821_cmd_poll()
+{
+    if (!dev->cmd.busy)
+        return dev->cmd.result;
+
+    uint8_t stat;
+    if (!i2c_read_bytes(CMD_STAT_REG, &stat, 1))
+        stat = dev->cmd.cmd; // 没读到按执行中算, 到时限为止
+    if (stat >= 0x10)
+    { // 仍是命令字节: 执行中
+        if (time_us_64() >= dev->cmd.deadline_us)
+            cmd_finish(TMF8821_ERR_TIMEOUT);
+        else
+            return TMF8821_PENDING;
+    }
+    else if (stat == STAT_OK || stat == STAT_ACCEPTED)
+        cmd_finish(TMF8821_OK);
+    else
+        cmd_finish(TMF8821_ERR_CMD);
+    return dev->cmd.result;
+}
+
+// 轮询直到当前命令完成
+int tmf8821_cmd_wait()
+{
+    int result;
+    while ((result = tmf8821_cmd_poll()) == TMF8821_PENDING)
+    {
+        tight_loop_contents();
+    }
+    return result;
+}
+
+bool tmf8821_cmd_busy()
+{
+    return dev->cmd.busy;
+}
+
+// 执行一条命令并等待完成
+int tmf8821_command(uint8_t cmd, uint32_t timeout_us)
+{
+    int result = tmf8821_cmd_submit(cmd, timeout_us, NULL, NULL);
+    if (result != TMF8821_OK)
+        return result;
+    return tmf8821_cmd_wait();
+}
+
+void tmf8821_get_cmd_stats(uint8_t cmd, tmf8821_cmd_stats_t *stats)
+{
+    *stats = *cmd_stats_slot(cmd);
+}
+
+// 加载公共配置页面
+int load_common_config()
+{
+    int result = tmf8821_command(COMMON_CONFIG_REG, TMF8821_CMD_TIMEOUT_US); // 加载公共配置页面
+    if (result == TMF8821_OK)
+        LOG_D(LOG_CONFIG_LOADED);
+    return result;
+}
+
+#define SHADOW_ALL ((uint32_t)((1ull << TMF8821_SHADOW_SIZE) - 1))
+
+static bool shadow_covers(uint8_t reg)
+{
+    return reg >= CONFIG_RESULT_REG && reg < CONFIG_RESULT_REG + TMF8821_SHADOW_SIZE;
+}
+
+// 只改影子, 与已知值相同时不标脏; 影子以外的寄存器不处理
+void tmf8821_shadow_set(uint8_t reg, uint8_t value)
+{
+    tmf8821_shadow_t *sh = &dev->shadow;
+    if (!shadow_covers(reg))
+        return;
+    uint8_t i = reg - CONFIG_RESULT_REG;
+    sh->stats.sets++;
+    if ((sh->known >> i & 1) && sh->cfg[i] == value)
+    {
+        sh->stats.unchanged++;
+        return;
+    }
+    sh->cfg[i] = value;
+    sh->known |= 1u << i;
+    sh->dirty |= 1u << i;
+}
+
+// 小端16位字段
+void tmf8821_shadow_set16(uint8_t reg, uint16_t value)
+{
+    tmf8821_shadow_set(reg, value & 0xFF);
+    tmf8821_shadow_set(reg + 1, value >> 8);
+}
+
+// 传感器重新启动过, 影子里的值都不再可信; 统计保留
+void tmf8821_shadow_invalidate()
+{
+    dev->shadow.known = 0;
+    dev->shadow.dirty = 0;
+    dev->shadow.int_enab_known = false;
+}
+
+void tmf8821_get_shadow_stats(tmf8821_shadow_stats_t *stats)
+{
+    *stats = dev->shadow.stats;
+}
+
+// 补齐影子里未知的字节, 须已载入公共配置页: 一次读整页并确认页头, 待写的字节不被覆盖
+static int shadow_fetch()
+{
+    tmf8821_shadow_t *sh = &dev->shadow;
+    uint8_t page[TMF8821_SHADOW_SIZE];
+    if (sh->known == SHADOW_ALL)
+    {
+        sh->stats.reads_cached++;
+        return TMF8821_OK;
+    }
+    sh->stats.reads++;
+    if (!i2c_read_bytes(CONFIG_RESULT_REG, page, sizeof(page)))
+        return TMF8821_ERR_IO;
+    if (page[0] != COMMON_CONFIG_REG || page[2] != 0xBC || page[3] != 0x00)
+    {
+        LOG_W(LOG_BAD_CONFIG_PAGE, page[0], page[2], page[3]);
+        return TMF8821_ERR_CMD;
+    }
+    for (uint8_t i = 0; i < TMF8821_SHADOW_SIZE; i++)
+    {
+        if (!(sh->dirty >> i & 1))
+            sh->cfg[i] = page[i];
+    }
+    sh->known = SHADOW_ALL;
+    return TMF8821_OK;
+}
+
+// 把脏字节按段突发写出, 一段从一个脏字节延伸到其后最远的、中间没有未知字节的脏字节
+static bool shadow_flush()
+{
+    tmf8821_shadow_t *sh = &dev->shadow;
+    uint8_t i = 0;
+    while (i < TMF8821_SHADOW_SIZE)
+    {
+        if (!(sh->dirty >> i & 1))
         {
-            // 设备处于STANDBY_TIMED模式 (bit 6 = 0, bit 1 = 1, bit 2 = 1)
-            printf("Device is in STANDBY_TIMED mode. Forcing wake up...\n");
-            uint8_t new_value = (enable_value & 0x30) | 0x01; // 保持bit 5和4，设置bit 0为1
-            i2c_write_byte(ENABLE_REG, new_value);            // 写入新值强制唤醒设备
-            sleep_ms(10);                                     // 等待10ms
+            i++;
+            continue;
         }
-        else
+        uint8_t end = i + 1;
+        for (uint8_t j = end; j < TMF8821_SHADOW_SIZE && (sh->known >> j & 1); j++)
         {
-            // 未知状态
-            printf("Unexpected ENABLE register value: 0x%02X\n", enable_value);
-            break;
+            if (sh->dirty >> j & 1)
+                end = j + 1;
         }
+        if (!i2c_write_bytes(CONFIG_RESULT_REG + i, &sh->cfg[i], end - i))
+            return false;
+        sh->stats.writes++;
+        sh->stats.bytes += end - i;
+        i = end;
     }
+    sh->dirty = 0;
+    return true;
 }
 
-// 加载公共配置页面
-void load_common_config()
+// 预置测量配置
+const tmf8821_config_t tmf8821_profiles[] = {
+    // 名称        周期ms  千次迭代 SPAD 置信度 GPIO0 GPIO1 直方图
+    {"default",    80,     537,     6,   6,     0x03, 0x00, 0},
+    {"fast",       10,     128,     6,   4,     0x03, 0x00, 0}, // 短距离, 高帧率
+    {"accurate",   250,    4000,    6,   12,    0x03, 0x00, 0}, // 慢速高精度
+    {"histogram",  100,    537,     6,   6,     0x03, 0x00, 1}, // 原始直方图输出
+    {"4x4",        40,     268,     7,   6,     0x03, 0x00, 0}, // 分时复用, 80 ms一幅
+    {"3x6",        40,     268,     10,  6,     0x03, 0x00, 0}, // 分时复用, 80 ms一幅
+};
+const uint8_t tmf8821_profile_count = sizeof(tmf8821_profiles) / sizeof(tmf8821_profiles[0]);
+
+// 分时复用的两次子采集各取半幅: 4x4为左右两半各2列, 3x6为左右两半各3列
+const tmf8821_spad_map_t tmf8821_spad_maps[] = {
+    {SPAD_MAP_3X3_NORMAL, "3x3", 3, 3, 1, {{0, 1, 2, 3, 4, 5, 6, 7, 8}}},
+    {SPAD_MAP_3X3_MACRO, "3x3 macro", 3, 3, 1, {{0, 1, 2, 3, 4, 5, 6, 7, 8}}},
+    {SPAD_MAP_3X3_WIDE, "3x3 wide", 3, 3, 1, {{0, 1, 2, 3, 4, 5, 6, 7, 8}}},
+    {SPAD_MAP_4X4_NORMAL, "4x4", 4, 4, 2,
+     {{0, 1, 4, 5, 8, 9, 12, 13, SPAD_ZONE_NONE}, {2, 3, 6, 7, 10, 11, 14, 15, SPAD_ZONE_NONE}}},
+    {SPAD_MAP_3X6, "3x6", 3, 6, 2, {{0, 1, 2, 6, 7, 8, 12, 13, 14}, {3, 4, 5, 9, 10, 11, 15, 16, 17}}},
+};
+const uint8_t tmf8821_spad_map_count = sizeof(tmf8821_spad_maps) / sizeof(tmf8821_spad_maps[0]);
+
+// 表里没有的图按3x3单次采集处理
+const tmf8821_spad_map_t *tmf8821_find_spad_map(uint8_t id)
 {
-    i2c_write_byte(CMD_STAT_REG, COMMON_CONFIG_REG); // 加载公共配置页面
-    while (i2c_read_byte(CMD_STAT_REG) != 0x00)
-    { // 等待命令完成
-        sleep_ms(10);
+    for (uint8_t i = 0; i < tmf8821_spad_map_count; i++)
+    {
+        if (tmf8821_spad_maps[i].id == id)
+            return &tmf8821_spad_maps[i];
+    }
+    return &tmf8821_spad_maps[0];
+}
+
+const tmf8821_config_t *tmf8821_find_profile(const char *name)
+{
+    for (uint8_t i = 0; i < tmf8821_profile_count; i++)
+    {
+        if (strcmp(tmf8821_profiles[i].name, name) == 0)
+            return &tmf8821_profiles[i];
+    }
+    return NULL;
+}
+
+// 写入测量配置: 各字段先记进影子, 与传感器里的都相同时什么也不发;
+// 否则载入公共配置页, 影子不全时读一次整页补齐, 脏字节合并写出后提交.
+// 测量进行中时调用者需先停止测量
+int tmf8821_apply_config(const tmf8821_config_t *config)
+{
+    tmf8821_shadow_set16(CFG_PERIOD_MS_REG, config->period_ms);
+    tmf8821_shadow_set16(CFG_KILO_ITERATIONS_REG, config->kilo_iterations);
+    tmf8821_shadow_set(CFG_CONFIDENCE_THRESHOLD_REG, config->confidence_threshold);
+    tmf8821_shadow_set(CFG_GPIO_0_REG, config->gpio_0);
+    tmf8821_shadow_set(CFG_GPIO_1_REG, config->gpio_1);
+    tmf8821_shadow_set(CFG_SPAD_MAP_ID_REG, config->spad_map_id);
+    tmf8821_shadow_set(CFG_HIST_DUMP_REG, config->hist_dump);
+
+    if (!dev->shadow.dirty)
+    {
+        dev->shadow.stats.skipped++;
+        LOG_D(LOG_CONFIG_UNCHANGED, dev->addr);
+        return TMF8821_OK;
     }
-    printf("Common configuration page loaded.\n");
+    int result = load_common_config();
+    if (result == TMF8821_OK)
+        result = shadow_fetch();
+    if (result == TMF8821_OK)
+        result = write_common_config();
+    if (result == TMF8821_OK)
+        LOG_I(LOG_CONFIG_APPLIED, dev->addr, config->period_ms, config->spad_map_id);
+    return result;
+}
+
+// 工厂标定: 须先写好测量配置(标定按当前SPAD图做), 完成后读出标定数据(CALIB_DATA_SIZE字节)
+int tmf8821_factory_calibrate(uint8_t *data)
+{
+    int result = tmf8821_command(FACTORY_CALIB_CMD, TMF8821_CALIB_TIMEOUT_US);
+    if (result != TMF8821_OK)
+        return result;
+    return tmf8821_read_calibration(data);
 }
 
-// 配置测量周期为100ms
-void set_measurement_period()
+// 载入标定页并一次读出
+int tmf8821_read_calibration(uint8_t *data)
 {
-    i2c_write_byte(0x24, 0x50); // 设置测量周期为100ms
-    i2c_write_byte(0x25, 0x00); // 高位字节
-    printf("Measurement period set to 100ms.\n");
+    uint8_t page[CALIB_DATA_REG - CONFIG_RESULT_REG + CALIB_DATA_SIZE];
+    int result = tmf8821_command(LOAD_CONFIG_CALIB_CMD, TMF8821_CMD_TIMEOUT_US);
+    if (result != TMF8821_OK)
+        return result;
+    if (!i2c_read_bytes(CONFIG_RESULT_REG, page, sizeof(page)))
+        return TMF8821_ERR_IO;
+    if (page[0] != CALIB_PAGE_ID)
+        return TMF8821_ERR_CMD;
+    memcpy(data, &page[CALIB_DATA_REG - CONFIG_RESULT_REG], CALIB_DATA_SIZE);
+    return TMF8821_OK;
 }
 
-// 选择SPAD掩码6
-void set_spad_mask()
+// 写回标定数据: 载入标定页, 一次突发写入, 再提交; 在开始测量前做
+int tmf8821_write_calibration(const uint8_t *data)
 {
-    i2c_write_byte(0x34, 0x06); // 选择SPAD掩码6
-    printf("SPAD mask set to 6.\n");
+    int result = tmf8821_command(LOAD_CONFIG_CALIB_CMD, TMF8821_CMD_TIMEOUT_US);
+    if (result != TMF8821_OK)
+        return result;
+    if (!i2c_write_bytes(CALIB_DATA_REG, data, CALIB_DATA_SIZE))
+        return TMF8821_ERR_IO;
+    return tmf8821_command(WRITE_CONFIG_CMD, TMF8821_CMD_TIMEOUT_US);
 }
 
-// 写入公共配置页面
-void write_common_config()
+// 写入公共配置页面: 须已载入公共配置页, 先把影子里的脏字节写出再提交;
+// 提交失败时不知道传感器里是哪个版本, 影子作废
+int write_common_config()
 {
-    i2c_write_byte(CMD_STAT_REG, 0x15); // 写入公共配置页面
-    while (i2c_read_byte(CMD_STAT_REG) != 0x00)
-    { // 等待命令完成
-        sleep_ms(10);
+    if (!shadow_flush())
+        return TMF8821_ERR_IO;
+    int result = tmf8821_command(WRITE_CONFIG_CMD, TMF8821_CMD_TIMEOUT_US); // 写入公共配置页面
+    if (result == TMF8821_OK)
+        LOG_D(LOG_CONFIG_WRITTEN);
+    else
+    {
+        dev->shadow.known = 0;
+        dev->shadow.dirty = 0;
     }
-    printf("Common configuration page written.\n");
+    return result;
 }
 
-// 启用结果中断
+// 启用结果中断, 已经是这个值时不写
 void enable_interrupts()
 {
-    i2c_write_byte(INT_ENAB_REG, 0x02); // 启用结果中断
-    printf("Result interrupts enabled.\n");
+    tmf8821_shadow_t *sh = &dev->shadow;
+    uint8_t enab = INT_RESULT | INT_HIST; // 启用结果和直方图中断
+    sh->stats.sets++;
+    if (sh->int_enab_known && sh->int_enab == enab)
+        sh->stats.unchanged++;
+    else if (i2c_write_byte(INT_ENAB_REG, enab))
+    {
+        sh->int_enab = enab;
+        sh->int_enab_known = true;
+        sh->stats.writes++;
+        sh->stats.bytes++;
+    }
+    LOG_D(LOG_INT_ENABLED);
 }
 
 // 清除中断
 void clear_interrupts()
 {
     i2c_write_byte(INT_CLEAR_REG, 0xFF); // 清除所有中断
-    printf("Interrupts cleared.\n");
+    LOG_D(LOG_INT_CLEARED);
 }
 
 // 启动测量
-void start_measurement()
+int start_measurement()
 {
-    i2c_write_byte(CMD_STAT_REG, MEASURE_CMD); // 启动测量
-    while (i2c_read_byte(CMD_STAT_REG) != 0x01)
-    { // 等待命令完成
-        sleep_ms(10);
-    }
-    printf("Measurement started.\n");
+    int result = tmf8821_command(MEASURE_CMD, TMF8821_CMD_TIMEOUT_US); // 启动测量
+    if (result == TMF8821_OK)
+        LOG_I(LOG_MEASURE_STARTED);
+    return result;
 }
 
 // 停止测量
-void stop_measurement()
-{
-    i2c_write_byte(CMD_STAT_REG, STOP_CMD); // 停止测量
-    while (i2c_read_byte(CMD_STAT_REG) != 0x00)
-    { // 等待命令完成
-        sleep_ms(10);
-    }
-    printf("Measurement stopped.\n");
-}
-
-// 读取测量结果
-void read_measurement_results(uint16_t *res)
-{
-    uint8_t result_id = i2c_read_byte(0x20); // 读取结果ID
-    if (result_id == 0x10)
-    { // 检查是否为测量结果
-        uint8_t conf = 0;
-        uint8_t dm;
-        uint8_t dl;
-        uint8_t i = 0x38;
-        uint8_t j = 0;
-        // uint8_t k = 0;
-        // dl = i2c_read_byte(0x3C);
-        //     dm = i2c_read_byte(0x3D);
-        //     printf("value: 0x%02X%02X    ", dm, dl);
-        while (1)
+int stop_measurement()
+{
+    int result = tmf8821_command(STOP_CMD, TMF8821_CMD_TIMEOUT_US); // 停止测量
+    if (result == TMF8821_OK)
+        LOG_I(LOG_MEASURE_STOPPED);
+    return result;
+}
+
+// 一次突发读取整个结果页(结果ID、结果编号、温度、有效数、9区×2目标)
+bool read_result_frame(uint8_t *frame)
+{
+    bool ok = i2c_read_bytes(CONFIG_RESULT_REG, frame, RESULT_FRAME_SIZE) && frame[0] == RESULT_PAGE_ID;
+    TRACE(TRACE_RESULT_READ, ok, frame[4]);
+    return ok;
+}
+
+// 一次突发读取一个直方图包(头部 + 128字节)
+bool read_hist_packet(uint8_t *packet)
+{
+    bool ok = i2c_read_bytes(CONFIG_RESULT_REG, packet, HIST_PACKET_SIZE) && packet[0] == HIST_PAGE_ID &&
+              packet[1] < HIST_PACKETS;
+    TRACE(TRACE_HIST_READ, ok, packet[1]);
+    return ok;
+}
+
+void tmf8821_seq_init(tmf8821_seq_t *seq, uint16_t period_ms)
+{
+    *seq = (tmf8821_seq_t){.period_ms = period_ms};
+}
+
+// 记一帧, 返回这一帧之前丢掉的帧数
+// 编号差与按时间估计的帧数相差半圈以上时, 按时间补上整圈
+uint32_t tmf8821_seq_update(tmf8821_seq_t *seq, uint8_t number, uint32_t timestamp_us)
+{
+    uint32_t lost = 0;
+    if (seq->started)
+    {
+        uint32_t gap = (uint8_t)(number - seq->last_number);
+        if (seq->period_ms)
         {
-            res[j] = i2c_read_byte(i+j);
-            j++;
-            if(j>=27)
-                break;
+            uint32_t period_us = seq->period_ms * 1000u;
+            uint32_t expected = (timestamp_us - seq->last_us + period_us / 2) / period_us;
+            if (expected > gap + 128)
+                gap += (expected - gap + 128) / 256 * 256;
         }
+        if (gap == 0)
+            seq->repeats++;
+        else
+            lost = gap - 1;
     }
-    else
-    {
-        printf("Unexpected result ID: 0x%02X\n", result_id);
-    }
+    seq->started = true;
+    seq->last_number = number;
+    seq->last_us = timestamp_us;
+    seq->frames++;
+    seq->lost += lost;
+    return lost;
 }
 
-void check_cmd()
+// 选择之后驱动函数操作的传感器: 切换到它的总线和地址
+void tmf8821_select(tmf8821_dev_t *d)
 {
-    uint8_t data[3];
-    while (true)
-    {
-        sleep_ms(1);
-        i2c_read_bytes(CMD_STAT_REG, data, 3);
-        printf("ready register value: 0x%02X 0x%02X 0x%02X\n", data[0], data[1], data[2]);
-        if (data[2] == 0xff)
-            break;
-        sleep_ms(2);
-    }
+    dev = d;
+    if (d->bus)
+        i2c_set_transport(d->bus, d->bus_hz);
+    i2c_set_address(d->addr);
 }
 
-void check_conf()
+tmf8821_dev_t *tmf8821_selected()
 {
-    uint8_t data[3];
-    while (true)
-    {
-        sleep_ms(1);
-        i2c_read_bytes(CONFIG_RESULT_REG, data, 4);
-        printf("Check configuration register value: 0x%02X 0x%02X 0x%02X 0x%02X\n", data[0], data[1], data[2], data[3]);
-        if ((data[0] == 0x16) && (data[2] == 0xbc) && (data[3] == 0x00))
-            break;
-        sleep_ms(2);
+    return dev;
+}
+
+// 原样存下和恢复, 不经tmf8821_select: 启动改地址期间总线上的地址还不是d->addr
+void tmf8821_save_selection(tmf8821_selection_t *sel)
+{
+    sel->dev = dev;
+    i2c_get_target(&sel->target);
+}
+
+void tmf8821_restore_selection(const tmf8821_selection_t *sel)
+{
+    dev = sel->dev;
+    i2c_set_target(&sel->target);
+}
+
+// 修改当前传感器的I²C地址: 写入配置页后发I2C_ADDRESS命令, 完成时已在新地址上应答
+int tmf8821_set_i2c_address(uint8_t addr)
+{
+    int result = load_common_config();
+    if (result != TMF8821_OK)
+        return result;
+    tmf8821_shadow_set(CFG_I2C_ADDRESS_REG, addr << 1);
+    tmf8821_shadow_set(CFG_I2C_ADDR_CHANGE_REG, 0);
+    if ((result = write_common_config()) != TMF8821_OK)
+        return result;
+
+    if ((result = tmf8821_cmd_submit(I2C_ADDRESS_CMD, TMF8821_CMD_TIMEOUT_US, NULL, NULL)) != TMF8821_OK)
+        return result;
+    dev->addr = addr;
+    i2c_set_address(addr);
+    while (!i2c_probe())
+    { // 改址完成前新地址不应答
+        if (time_us_64() >= dev->cmd.deadline_us)
+        {
+            cmd_finish(TMF8821_ERR_TIMEOUT);
+            return TMF8821_ERR_TIMEOUT;
+        }
     }
-}
\ No newline at end of file
+    return tmf8821_cmd_wait();
+}
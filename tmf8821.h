@@ -8,29 +8,335 @@
 #define ENABLE_REG 0xE0
 #define CMD_STAT_REG 0x08
 #define APPID_REG 0x00
+#define APPREV_MAJOR_REG 0x01
+#define APPREV_MINOR_REG 0x12
 #define INT_ENAB_REG 0xE2
 #define INT_CLEAR_REG 0xE1
 #define COMMON_CONFIG_REG 0x16
 #define MEASURE_CMD 0x10
 #define STOP_CMD 0x11
+#define WRITE_CONFIG_CMD 0x15
+#define STAT_OK 0x00
+#define STAT_ACCEPTED 0x01
 #define CONFIG_RESULT_REG 0x20
 
+// 公共配置页字段(LOAD_CONFIG之后位于0x20起)
+#define CFG_PERIOD_MS_REG 0x24
+#define CFG_KILO_ITERATIONS_REG 0x26
+#define CFG_CONFIDENCE_THRESHOLD_REG 0x30
+#define CFG_GPIO_0_REG 0x31
+#define CFG_GPIO_1_REG 0x32
+#define CFG_SPAD_MAP_ID_REG 0x34
+#define CFG_HIST_DUMP_REG 0x39
+#define CFG_I2C_ADDRESS_REG 0x3B // 7位地址左移1位
+#define CFG_I2C_ADDR_CHANGE_REG 0x3C // 按GPIO条件改址, 0为无条件
+#define I2C_ADDRESS_CMD 0x21
+#define CFG_PAGE_SIZE (CFG_HIST_DUMP_REG + 1 - CONFIG_RESULT_REG)
+
+// 工厂标定: 在最终结构里、40cm内无目标且环境光暗时做一次, 按当前SPAD图标定;
+// 结果在标定页(0x20起, ID 0x19), 头部4字节之后为数据. 写回时载入标定页、写数据、WRITE_CONFIG
+#define FACTORY_CALIB_CMD 0x20
+#define LOAD_CONFIG_CALIB_CMD 0x19
+#define CALIB_PAGE_ID 0x19
+#define CALIB_DATA_REG 0x24
+#define CALIB_DATA_SIZE 188 // 0x24..0xDF
+#define TMF8821_CALIB_TIMEOUT_US 1000000
+
+// ENABLE 位: 待机时固件和配置都留在RAM里, 置PON后CPU就绪即可继续测量
+#define ENABLE_PON 0x01
+#define ENABLE_STANDBY 0x02       // 读出: 待机
+#define ENABLE_STANDBY_TIMED 0x04 // 读出: 定时待机(与ENABLE_STANDBY同时为1)
+#define ENABLE_POWERUP_SELECT 0x30
+#define ENABLE_CPU_READY 0x40
+
+// 电源状态(tmf8821_power_state)
+#define TMF8821_POWER_READY 0
+#define TMF8821_POWER_INIT 1 // 已置PON, CPU还在初始化
+#define TMF8821_POWER_STANDBY 2
+#define TMF8821_POWER_STANDBY_TIMED 3
+#define TMF8821_POWER_UNKNOWN 4
+#define TMF8821_WAKE_TIMEOUT_US 20000
+
+// INT_STATUS / INT_ENAB 位
+#define INT_RESULT 0x02
+#define INT_HIST 0x04
+#define RESULT_PAGE_ID 0x10
+#define TMF8821_APPID_MEASURE 0x03
+
+#define TMF8821_OK 0
+#define TMF8821_ERR_TIMEOUT -1
+#define TMF8821_ERR_SIZE -2
+#define TMF8821_ERR_BUSY -3 // 已有命令在执行
+#define TMF8821_ERR_CMD -4  // 传感器返回错误状态
+#define TMF8821_ERR_IO -5   // I²C传输重试用完仍失败
+#define TMF8821_PENDING 1
+
+#define TMF8821_CMD_TIMEOUT_US 100000
+#define TMF8821_CMD_STATS 17 // 0x10..0x1F各一项, 其余命令共用最后一项
+
+// 固件下载: 引导程序单个W_RAM最大0x80字节
+#define FW_CHUNK_MAX 0x80
+#define FW_MAX_CHUNKS 64
+#define FW_CMD_TIMEOUT_US 20000
+#define FW_BOOT_TIMEOUT_US 100000
+
+// 结果页: 0x20起, 头部24字节, 之后每个结果为置信度+距离(LSB, MSB)
+#define RESULT_ZONE_OFFSET 0x18
+#define RESULT_ZONES 9
+#define RESULT_OBJECTS 2
+#define RESULT_FRAME_SIZE (RESULT_ZONE_OFFSET + RESULT_ZONES * RESULT_OBJECTS * 3)
+
+// 结果页按寄存器布局定义的打包结构, 直接套在突发读的缓冲区上解析, 不拷贝;
+// 多字节字段为小端, 与RP2040相同. 一帧78字节, 不再按字节拆成uint16_t数组
+typedef struct __attribute__((packed))
+{
+    uint8_t confidence; // 0为无目标
+    uint16_t distance_mm;
+} tmf8821_object_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t page_id;         // RESULT_PAGE_ID
+    uint8_t reserved0;
+    uint16_t payload_size;   // 其后的字节数
+    uint8_t number;          // 结果编号, 每帧加1
+    uint8_t temperature;     // °C
+    uint8_t valid_results;
+    uint8_t reserved1;
+    uint32_t ambient_light;
+    uint32_t photon_count;
+    uint32_t reference_count;
+    uint32_t sys_tick;       // 传感器时钟(0.2 µs), 最低位为有效标志
+    tmf8821_object_t objects[RESULT_OBJECTS][RESULT_ZONES]; // 先是各区第一目标, 再是第二目标
+} tmf8821_frame_t;
+
+_Static_assert(sizeof(tmf8821_object_t) == 3, "result record is 3 bytes");
+_Static_assert(sizeof(tmf8821_frame_t) == RESULT_FRAME_SIZE, "frame layout must match the result page");
+
+// 原始直方图: 5个TDC×2通道, 每通道128格24位计数
+// 每个直方图包(0x20起, ID 0x81)带某一通道一个字节平面: 包号 = 通道*3 + 平面(0为低字节)
+// 传感器每发一个包拉一次INT(INT_HIST), 主机读完并清中断后才发下一包
+#define HIST_PAGE_ID 0x81
+#define HIST_HEADER_SIZE 4
+#define HIST_PACKET_DATA 128
+#define HIST_PACKET_SIZE (HIST_HEADER_SIZE + HIST_PACKET_DATA)
+#define HIST_CHANNELS 10
+#define HIST_BINS 128
+#define HIST_PACKETS (HIST_CHANNELS * 3)
+
+// 启动统计: 冷启动(下载固件)与热启动(跳过下载)分别计时
+typedef struct
+{
+    uint32_t cold_starts;
+    uint32_t warm_starts;
+    uint32_t cold_start_us;
+    uint32_t warm_start_us;
+} tmf8821_boot_stats_t;
+
+// 待机/唤醒: 唤醒耗时 = 写PON到CPU就绪, 首帧耗时 = 写PON到唤醒后第一帧的INT
+typedef struct
+{
+    uint32_t standbys;
+    uint32_t wakes;
+    uint32_t wake_us;            // 最近一次
+    uint32_t first_frame_us;     // 最近一次, 0为还没等到首帧
+    uint32_t first_frame_max_us;
+    uint32_t wake_start_us;
+    bool waking;                 // 等CPU就绪
+    bool awaiting_frame;         // 等唤醒后的第一帧
+} tmf8821_power_stats_t;
+
+// SPAD图(CFG_SPAD_MAP_ID): 3x3各图一次采集出9区; 4x4和3x6为分时复用,
+// 相邻两次测量交替用两组SPAD, 每个结果页只带半幅的区(4x4每次8区, 3x6每次9区).
+// 开始测量后的第一个结果页为第一次子采集, 之后按结果编号与它的差依次轮换
+#define SPAD_MAP_3X3_NORMAL 1
+#define SPAD_MAP_3X3_MACRO 2
+#define SPAD_MAP_3X3_WIDE 6
+#define SPAD_MAP_4X4_NORMAL 7
+#define SPAD_MAP_3X6 10
+#define TMF8821_ZONES_MAX 18
+#define TMF8821_SUB_FRAMES_MAX 2
+#define SPAD_ZONE_NONE 0xFF
+
+typedef struct
+{
+    uint8_t id;
+    const char *name;
+    uint8_t rows;
+    uint8_t cols;
+    uint8_t sub_frames; // 拼一幅要的结果页数, 须整除256(结果编号回绕)
+    uint8_t zone_of[TMF8821_SUB_FRAMES_MAX][RESULT_ZONES]; // 子采集的第几个结果 -> 行优先的区号
+} tmf8821_spad_map_t;
+
+extern const tmf8821_spad_map_t tmf8821_spad_maps[];
+extern const uint8_t tmf8821_spad_map_count;
+
+// 测量配置, 一次突发写入公共配置页
+typedef struct
+{
+    const char *name;
+    uint16_t period_ms;
+    uint16_t kilo_iterations;
+    uint8_t spad_map_id;
+    uint8_t confidence_threshold;
+    uint8_t gpio_0;
+    uint8_t gpio_1;
+    uint8_t hist_dump; // 1: 每次测量前输出原始直方图
+} tmf8821_config_t;
+
+extern const tmf8821_config_t tmf8821_profiles[];
+extern const uint8_t tmf8821_profile_count;
+
+typedef void (*tmf8821_cmd_cb)(uint8_t cmd, int result, uint32_t latency_us, void *user);
+
+typedef struct
+{
+    uint8_t cmd;
+    bool busy;
+    int result;
+    uint32_t latency_us;
+    uint64_t start_us;
+    uint64_t deadline_us;
+    tmf8821_cmd_cb cb;
+    void *user;
+} tmf8821_cmd_t;
+
+// 分步固件下载的进度, 每次tmf8821_boot_poll()最多发一条引导程序命令
+typedef struct
+{
+    const uint8_t *image;
+    uint32_t length;
+    uint32_t chunk;      // 下一个要写的块
+    uint8_t phase;       // 0为空闲
+    uint64_t start_us;
+    uint64_t deadline_us;
+} tmf8821_download_t;
+
+// 寄存器影子: 传感器里已提交的公共配置页(0x20..0x3C)和INT_ENAB. 设置函数只改影子并标脏,
+// write_common_config()把脏字节合并成尽量少的突发写再提交, 影子完整时不再读回整页.
+// 两段脏字节之间的字节都已知时连同它们一起写成一段: 多写几个字节比多一次事务(地址、寄存器、
+// 起止位和驱动里的重试开销)便宜. 启动(下载或热启动)时作废, 待机不影响
+#define TMF8821_SHADOW_SIZE (CFG_I2C_ADDR_CHANGE_REG + 1 - CONFIG_RESULT_REG)
+
+typedef struct
+{
+    uint32_t sets;         // 设置调用
+    uint32_t unchanged;    // 与已知值相同, 没标脏
+    uint32_t writes;       // 发出的突发写
+    uint32_t bytes;        // 写出的字节, 含连起来的干净字节
+    uint32_t reads;        // 整页读回
+    uint32_t reads_cached; // 影子完整, 省掉的整页读回
+    uint32_t skipped;      // 没有改动, 省掉的整次载入/提交
+} tmf8821_shadow_stats_t;
+
+typedef struct
+{
+    uint8_t cfg[TMF8821_SHADOW_SIZE];
+    uint32_t known;        // 按字节: 与传感器一致, 或是待写的新值
+    uint32_t dirty;        // 按字节: 待写
+    uint8_t int_enab;
+    bool int_enab_known;
+    tmf8821_shadow_stats_t stats;
+} tmf8821_shadow_t;
+
+_Static_assert(TMF8821_SHADOW_SIZE <= 32, "shadow bitmaps are 32 bits");
+
+// 结果帧序号跟踪: 结果编号只有8位, 两帧之间隔了一整圈以上时用MCU时间戳和测量周期补回
+typedef struct
+{
+    bool started;
+    uint8_t last_number;
+    uint32_t last_us;
+    uint16_t period_ms; // 0: 只看编号
+    uint32_t frames;
+    uint32_t lost;      // 编号跳过的帧
+    uint32_t repeats;   // 编号与上一帧相同, 同一帧读了两次
+} tmf8821_seq_t;
+
+// 每条命令的延时统计
+typedef struct
+{
+    uint32_t count;
+    uint32_t timeouts;
+    uint32_t errors;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} tmf8821_cmd_stats_t;
+
+// 一个传感器: 所在总线、工作地址和引脚, 以及它自己的命令和下载状态
+// 驱动函数都作用在tmf8821_select()选中的传感器上
+typedef struct
+{
+    const i2c_transport_t *bus; // NULL: 沿用i2c_set_transport设置的总线
+    uint32_t bus_hz;
+    uint8_t addr;               // 工作地址, 启动时由默认地址改过来
+    uint8_t pin_en;
+    uint8_t pin_int;
+    tmf8821_cmd_t cmd;
+    tmf8821_cmd_stats_t cmd_stats[TMF8821_CMD_STATS];
+    tmf8821_download_t download;
+    tmf8821_boot_stats_t boot;
+    tmf8821_power_stats_t power;
+    tmf8821_shadow_t shadow;
+} tmf8821_dev_t;
+
+// 当前选择(驱动上下文和I²C目标): 中断里临时选别的传感器前存下, 返回前恢复
+typedef struct
+{
+    tmf8821_dev_t *dev;
+    i2c_target_t target;
+} tmf8821_selection_t;
+
 uint8_t calculate_checksum(uint8_t cmd_stat, uint8_t size, uint8_t *data, uint8_t data_length);
-void download_init();
-void set_address(uint16_t address);
-void write_ram(uint8_t *data, uint8_t data_length);
-void ram_remap_reset();
-void check_device_ready();
-void load_common_config();
-void set_measurement_period();
-void set_spad_mask();
-void write_common_config();
+bool download_init();
+bool set_address(uint16_t address);
+bool ram_remap_reset();
+int tmf8821_download_firmware(const uint8_t *image, uint32_t length, uint32_t *elapsed_us);
+int tmf8821_boot(const uint8_t *image, uint32_t length, const uint8_t version[3]);
+int tmf8821_boot_begin(const uint8_t *image, uint32_t length, const uint8_t version[3]);
+int tmf8821_boot_poll();
+void tmf8821_get_boot_stats(tmf8821_boot_stats_t *stats);
+bool check_device_ready();
+int tmf8821_power_state();
+int tmf8821_standby();
+int tmf8821_wake_begin();
+int tmf8821_wake_poll();
+int tmf8821_wake();
+int tmf8821_resume();
+void tmf8821_power_frame(tmf8821_dev_t *d, uint32_t timestamp_us);
+int load_common_config();
+void tmf8821_shadow_set(uint8_t reg, uint8_t value);
+void tmf8821_shadow_set16(uint8_t reg, uint16_t value);
+void tmf8821_shadow_invalidate();
+void tmf8821_get_shadow_stats(tmf8821_shadow_stats_t *stats);
+int write_common_config();
 void enable_interrupts();
 void clear_interrupts();
-void start_measurement();
-void stop_measurement();
-void read_measurement_results(uint16_t* res);
-void check_cmd();
-void check_conf();
+int start_measurement();
+int stop_measurement();
+bool read_result_frame(uint8_t *frame);
+bool read_hist_packet(uint8_t *packet);
+void tmf8821_seq_init(tmf8821_seq_t *seq, uint16_t period_ms);
+uint32_t tmf8821_seq_update(tmf8821_seq_t *seq, uint8_t number, uint32_t timestamp_us);
+int tmf8821_apply_config(const tmf8821_config_t *config);
+int tmf8821_factory_calibrate(uint8_t *data);
+int tmf8821_read_calibration(uint8_t *data);
+int tmf8821_write_calibration(const uint8_t *data);
+const tmf8821_config_t *tmf8821_find_profile(const char *name);
+const tmf8821_spad_map_t *tmf8821_find_spad_map(uint8_t id);
+
+int tmf8821_cmd_submit(uint8_t cmd, uint32_t timeout_us, tmf8821_cmd_cb cb, void *user);
+int tmf8821_cmd_poll();
+int tmf8821_cmd_wait();
+bool tmf8821_cmd_busy();
+int tmf8821_command(uint8_t cmd, uint32_t timeout_us);
+void tmf8821_get_cmd_stats(uint8_t cmd, tmf8821_cmd_stats_t *stats);
+
+void tmf8821_select(tmf8821_dev_t *dev);
+tmf8821_dev_t *tmf8821_selected();
+void tmf8821_save_selection(tmf8821_selection_t *sel);
+void tmf8821_restore_selection(const tmf8821_selection_t *sel);
+int tmf8821_set_i2c_address(uint8_t addr);
 
 #endif
\ No newline at end of file
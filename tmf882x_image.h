@@ -7,4 +7,9 @@ extern const unsigned long tmf882x_image_finish;
 extern const unsigned long tmf882x_image_length;
 extern const unsigned char tmf882x_image[];
 
+// 加载此镜像后应用报告的版本(APPREV_MAJOR, APPREV_MINOR, APPREV_PATCH)
+#define TMF882X_IMAGE_APP_MAJOR 3
+#define TMF882X_IMAGE_APP_MINOR 0
+#define TMF882X_IMAGE_APP_PATCH 9
+
 #endif /* TMF882X_IMAGE_H */
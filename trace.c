@@ -0,0 +1,50 @@
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "trace.h"
+
+static trace_event_t rings[TRACE_CORES][TRACE_EVENTS];
+static volatile uint32_t heads[TRACE_CORES]; // 只由对应核写
+static volatile bool paused;
+
+// 写入当前核的环, 满了覆盖最旧的事件
+// 同一个核上中断和主循环都会记, 关中断的时间只有写一个事件
+void trace_record(uint8_t id, uint8_t a8, uint16_t a16)
+{
+    if (paused)
+        return;
+    uint32_t irq = save_and_disable_interrupts();
+    uint core = get_core_num();
+    uint32_t head = heads[core];
+    trace_event_t *e = &rings[core][head & (TRACE_EVENTS - 1)];
+    e->t_us = time_us_32();
+    e->id = id;
+    e->a8 = a8;
+    e->a16 = a16;
+    heads[core] = head + 1;
+    restore_interrupts(irq);
+}
+
+// 暂停期间的事件直接丢弃, 读取时环内容不再变化
+void trace_pause(bool p)
+{
+    paused = p;
+}
+
+uint32_t trace_count(uint8_t core)
+{
+    uint32_t head = heads[core];
+    return head < TRACE_EVENTS ? head : TRACE_EVENTS;
+}
+
+// index 0为环里最旧的事件
+trace_event_t trace_get(uint8_t core, uint32_t index)
+{
+    uint32_t first = heads[core] - trace_count(core);
+    return rings[core][(first + index) & (TRACE_EVENTS - 1)];
+}
+
+void trace_clear()
+{
+    for (uint8_t core = 0; core < TRACE_CORES; core++)
+        heads[core] = 0;
+}
@@ -0,0 +1,51 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 热路径跟踪: 带µs时间戳的事件写进内存环形缓冲, 每个核一个环, 写入不加锁
+// 记录一次只读一次定时器、写8字节; TRACE_ENABLED为0时跟踪点不产生代码
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+#define TRACE_CORES 2
+#define TRACE_EVENTS 2048 // 每核, 必须是2的幂
+
+// 事件号, 后面是 a8 / a16 的含义
+#define TRACE_IRQ_ENTER 1   // 传感器序号 / GPIO
+#define TRACE_IRQ_EXIT 2    // 传感器序号 / 中断状态
+#define TRACE_I2C 3         // 字节数(封顶255) / 事务耗时µs, 时间戳为事务结束
+#define TRACE_RESULT_READ 4 // 是否有效 / 结果编号
+#define TRACE_HIST_READ 5   // 是否有效 / 包号
+#define TRACE_FRAME_READY 6 // 传感器序号 / 结果编号(直方图为包号), 已放进队列
+#define TRACE_FRAME_DROP 7  // 传感器序号 / 0, 队列满
+#define TRACE_FRAME_OUT 8   // 传感器序号 / 入队到发出的µs(封顶65535), core0
+#define TRACE_CMD_SUBMIT 9  // 命令 / 0
+#define TRACE_CMD_DONE 10   // 命令 / 结果(int16)
+#define TRACE_DMA_START 11  // 传感器序号 / 从INT下降沿等了多少µs(总线被占用时)
+#define TRACE_DMA_DONE 12   // 传感器序号 / 整个DMA序列的µs, 0xFFFF为中止
+
+typedef struct
+{
+    uint32_t t_us;
+    uint8_t id;
+    uint8_t a8;
+    uint16_t a16;
+} trace_event_t;
+
+#if TRACE_ENABLED
+#define TRACE(id, a8, a16) trace_record((id), (a8), (a16))
+#else
+#define TRACE(id, a8, a16) ((void)0)
+#endif
+
+void trace_record(uint8_t id, uint8_t a8, uint16_t a16);
+
+// 读取端: 先暂停记录, 按从旧到新取出, 取完清空后恢复
+void trace_pause(bool paused);
+uint32_t trace_count(uint8_t core);
+trace_event_t trace_get(uint8_t core, uint32_t index);
+void trace_clear();
+
+#endif
@@ -0,0 +1,111 @@
+#include <string.h>
+#include "tusb.h"
+#include "pico/unique_id.h"
+
+#define USB_VID 0x2E8A // Raspberry Pi
+#define USB_PID 0x000A
+#define USB_BCD 0x0200
+
+#define EPNUM_CDC0_NOTIF 0x81
+#define EPNUM_CDC0_OUT 0x02
+#define EPNUM_CDC0_IN 0x82
+#define EPNUM_CDC1_NOTIF 0x83
+#define EPNUM_CDC1_OUT 0x04
+#define EPNUM_CDC1_IN 0x84
+
+enum
+{
+    ITF_NUM_CDC0 = 0,
+    ITF_NUM_CDC0_DATA,
+    ITF_NUM_CDC1,
+    ITF_NUM_CDC1_DATA,
+    ITF_NUM_TOTAL
+};
+
+enum
+{
+    STRID_LANGID = 0,
+    STRID_MANUFACTURER,
+    STRID_PRODUCT,
+    STRID_SERIAL,
+    STRID_CDC_DIAG,
+    STRID_CDC_DATA,
+};
+
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + CFG_TUD_CDC * TUD_CDC_DESC_LEN)
+
+static const tusb_desc_device_t desc_device = {
+    .bLength = sizeof(tusb_desc_device_t),
+    .bDescriptorType = TUSB_DESC_DEVICE,
+    .bcdUSB = USB_BCD,
+    // 多个CDC需要IAD
+    .bDeviceClass = TUSB_CLASS_MISC,
+    .bDeviceSubClass = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol = MISC_PROTOCOL_IAD,
+    .bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
+    .idVendor = USB_VID,
+    .idProduct = USB_PID,
+    .bcdDevice = 0x0200, // 与SDK单CDC描述符区分, 避免主机沿用缓存的驱动配置
+    .iManufacturer = STRID_MANUFACTURER,
+    .iProduct = STRID_PRODUCT,
+    .iSerialNumber = STRID_SERIAL,
+    .bNumConfigurations = 1,
+};
+
+static const uint8_t desc_configuration[] = {
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0x00, 100),
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC0, STRID_CDC_DIAG, EPNUM_CDC0_NOTIF, 8, EPNUM_CDC0_OUT, EPNUM_CDC0_IN, 64),
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC1, STRID_CDC_DATA, EPNUM_CDC1_NOTIF, 8, EPNUM_CDC1_OUT, EPNUM_CDC1_IN, 64),
+};
+
+static const char *const desc_strings[] = {
+    [STRID_MANUFACTURER] = "Raspberry Pi",
+    [STRID_PRODUCT] = "hello_usb TMF8821",
+    [STRID_CDC_DIAG] = "Diagnostics",
+    [STRID_CDC_DATA] = "Measurement data",
+};
+
+const uint8_t *tud_descriptor_device_cb(void)
+{
+    return (const uint8_t *)&desc_device;
+}
+
+const uint8_t *tud_descriptor_configuration_cb(uint8_t index)
+{
+    (void)index;
+    return desc_configuration;
+}
+
+const uint16_t *tud_descriptor_string_cb(uint8_t index, uint16_t langid)
+{
+    static uint16_t desc_str[1 + 32];
+    char serial[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+    const char *str;
+    (void)langid;
+
+    if (index == STRID_LANGID)
+    {
+        desc_str[1] = 0x0409; // 英语
+        desc_str[0] = (TUSB_DESC_STRING << 8) | 4;
+        return desc_str;
+    }
+    if (index == STRID_SERIAL)
+    {
+        pico_get_unique_board_id_string(serial, sizeof(serial));
+        str = serial;
+    }
+    else if (index < sizeof(desc_strings) / sizeof(desc_strings[0]) && desc_strings[index])
+        str = desc_strings[index];
+    else
+        return NULL;
+
+    size_t len = strlen(str);
+    if (len > 32)
+        len = 32;
+    for (size_t i = 0; i < len; i++)
+    {
+        desc_str[1 + i] = str[i];
+    }
+    desc_str[0] = (TUSB_DESC_STRING << 8) | (2 * len + 2);
+    return desc_str;
+}
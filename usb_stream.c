@@ -0,0 +1,145 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/stdio/driver.h"
+#include "pico/critical_section.h"
+#include "tusb.h"
+#include "usb_stream.h"
+
+// 乒乓缓冲: fill正在被写入, 另一块(若非空)正在发往USB
+static uint8_t stream_buf[2][USB_STREAM_BUF_SIZE];
+static uint16_t stream_len[2];
+static uint16_t send_offset;
+static uint8_t fill;
+static bool sending;
+static usb_stream_stats_t stats;
+
+// 诊断输出环形缓冲: 两个核都可能printf, 只有core0碰TinyUSB
+static uint8_t diag_buf[USB_DIAG_BUF_SIZE];
+static uint32_t diag_head;
+static uint32_t diag_tail;
+static critical_section_t diag_lock;
+
+static void diag_out_chars(const char *buf, int len)
+{
+    critical_section_enter_blocking(&diag_lock);
+    for (int i = 0; i < len; i++)
+    {
+        if (diag_head - diag_tail >= USB_DIAG_BUF_SIZE)
+        {
+            stats.diag_dropped += len - i;
+            break;
+        }
+        diag_buf[diag_head++ % USB_DIAG_BUF_SIZE] = buf[i];
+    }
+    critical_section_exit(&diag_lock);
+}
+
+static int diag_in_chars(char *buf, int len)
+{
+    if (!tud_cdc_n_available(USB_ITF_DIAG))
+        return PICO_ERROR_NO_DATA;
+    return tud_cdc_n_read(USB_ITF_DIAG, buf, len);
+}
+
+static stdio_driver_t diag_stdio = {
+    .out_chars = diag_out_chars,
+    .in_chars = diag_in_chars,
+#if PICO_STDIO_ENABLE_CRLF_SUPPORT
+    .crlf_enabled = PICO_STDIO_DEFAULT_CRLF,
+#endif
+};
+
+void usb_stream_init()
+{
+    critical_section_init(&diag_lock);
+    tusb_init();
+    stdio_set_driver_enabled(&diag_stdio, true);
+}
+
+static void diag_pump()
+{
+    critical_section_enter_blocking(&diag_lock);
+    uint32_t n = diag_head - diag_tail;
+    uint32_t off = diag_tail % USB_DIAG_BUF_SIZE;
+    critical_section_exit(&diag_lock);
+
+    if (n == 0 || !tud_cdc_n_connected(USB_ITF_DIAG))
+        return;
+    if (off + n > USB_DIAG_BUF_SIZE)
+        n = USB_DIAG_BUF_SIZE - off;
+    n = tud_cdc_n_write(USB_ITF_DIAG, &diag_buf[off], n);
+    tud_cdc_n_write_flush(USB_ITF_DIAG);
+
+    critical_section_enter_blocking(&diag_lock);
+    diag_tail += n;
+    critical_section_exit(&diag_lock);
+}
+
+static void stream_pump()
+{
+    uint8_t send = fill ^ 1;
+    if (!sending)
+    {
+        if (stream_len[fill] == 0)
+            return;
+        // 发送块空闲: 交换, 刚写满的那块开始发送
+        fill = send;
+        send = fill ^ 1;
+        send_offset = 0;
+        sending = true;
+    }
+
+    uint32_t avail = tud_cdc_n_write_available(USB_ITF_DATA);
+    uint32_t n = stream_len[send] - send_offset;
+    if (n > avail)
+        n = avail;
+    if (n)
+    {
+        tud_cdc_n_write(USB_ITF_DATA, &stream_buf[send][send_offset], n);
+        tud_cdc_n_write_flush(USB_ITF_DATA);
+        send_offset += n;
+        stats.bytes_sent += n;
+    }
+    if (send_offset == stream_len[send])
+    {
+        stream_len[send] = 0;
+        sending = false;
+    }
+}
+
+// 在core0主循环里反复调用
+void usb_stream_task()
+{
+    tud_task();
+    diag_pump();
+    stream_pump();
+}
+
+// 追加一个完整数据包, 两块缓冲都占满时丢弃并返回false
+bool usb_stream_write(const uint8_t *data, size_t len)
+{
+    if (stream_len[fill] + len > USB_STREAM_BUF_SIZE)
+    {
+        if (sending || len > USB_STREAM_BUF_SIZE)
+        {
+            stats.packets_dropped++;
+            return false;
+        }
+        stream_pump(); // 立即交换, 写入另一块
+    }
+    memcpy(&stream_buf[fill][stream_len[fill]], data, len);
+    stream_len[fill] += len;
+    stats.packets++;
+    return true;
+}
+
+// 现在写入len字节的包是否不会被丢弃, 供可以推迟的输出(如跟踪导出)先行检查
+bool usb_stream_writable(size_t len)
+{
+    return stream_len[fill] + len <= USB_STREAM_BUF_SIZE || (!sending && len <= USB_STREAM_BUF_SIZE);
+}
+
+void usb_stream_get_stats(usb_stream_stats_t *out)
+{
+    *out = stats;
+}
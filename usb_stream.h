@@ -0,0 +1,28 @@
+#ifndef USB_STREAM_H
+#define USB_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// USB输出: CDC0为诊断stdio, CDC1为测量数据
+// 数据经两块乒乓缓冲发送, 主机不读时丢包计数, 绝不阻塞
+#define USB_ITF_DIAG 0
+#define USB_ITF_DATA 1
+#define USB_STREAM_BUF_SIZE 1024
+#define USB_DIAG_BUF_SIZE 1024
+
+typedef struct
+{
+    uint32_t bytes_sent;
+    uint32_t packets;
+    uint32_t packets_dropped;
+    uint32_t diag_dropped; // 诊断输出溢出丢弃的字节
+} usb_stream_stats_t;
+
+void usb_stream_init();
+void usb_stream_task();
+bool usb_stream_write(const uint8_t *data, size_t len);
+bool usb_stream_writable(size_t len);
+void usb_stream_get_stats(usb_stream_stats_t *stats);
+
+#endif
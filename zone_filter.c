@@ -0,0 +1,119 @@
+#include <string.h>
+#include "zone_filter.h"
+
+const char *const zone_filter_names[ZONE_FILTER_MODES] = {"none", "median", "ema", "kalman"};
+
+static inline int32_t min32(int32_t a, int32_t b)
+{
+    return b ^ ((a ^ b) & -(a < b));
+}
+
+static inline int32_t max32(int32_t a, int32_t b)
+{
+    return a ^ ((a ^ b) & -(a < b));
+}
+
+// 无分支比较交换
+#define SORT2(a, b)                \
+    do                             \
+    {                              \
+        int32_t lo = min32(a, b);  \
+        b = max32(a, b);           \
+        a = lo;                    \
+    } while (0)
+
+// 5个数的排序网络(9次比较交换), 只取中间值
+static int32_t median5(int32_t a, int32_t b, int32_t c, int32_t d, int32_t e)
+{
+    SORT2(a, b);
+    SORT2(d, e);
+    SORT2(c, e);
+    SORT2(c, d);
+    SORT2(a, d);
+    SORT2(a, c);
+    SORT2(b, e);
+    SORT2(b, d);
+    SORT2(b, c);
+    return c;
+}
+
+void zone_filter_init(zone_filter_t *f, zone_filter_mode_t mode)
+{
+    memset(f, 0, sizeof(*f));
+    f->mode = mode < ZONE_FILTER_MODES ? mode : ZONE_FILTER_NONE;
+    for (int i = 0; i < ZONE_FILTER_CHANNELS; i++)
+        f->p[i] = ZONE_FILTER_KALMAN_P_MAX;
+}
+
+static void filter_median(zone_filter_t *f, const int32_t *z, const uint8_t *conf)
+{
+    for (int i = 0; i < ZONE_FILTER_CHANNELS; i++)
+    {
+        if (conf[i] && !(f->primed & (1u << i)))
+        { // 第一次有效测量填满窗口
+            for (int k = 0; k < ZONE_FILTER_MEDIAN_LEN; k++)
+                f->window[k][i] = z[i];
+            f->primed |= 1u << i;
+        }
+        f->window[f->pos][i] = conf[i] ? z[i] : f->est[i];
+        f->est[i] = median5(f->window[0][i], f->window[1][i], f->window[2][i], f->window[3][i], f->window[4][i]);
+    }
+    f->pos = f->pos + 1 < ZONE_FILTER_MEDIAN_LEN ? f->pos + 1 : 0;
+}
+
+static void filter_ema(zone_filter_t *f, const int32_t *z, const uint8_t *conf)
+{
+    for (int i = 0; i < ZONE_FILTER_CHANNELS; i++)
+    {
+        int32_t w = (ZONE_FILTER_EMA_ALPHA * conf[i]) >> 8; // 置信度为0时不更新
+        int32_t primed = -(int32_t)((f->primed >> i) & 1);
+        w = (w & primed) | (-(conf[i] != 0) & ~primed & 256); // 未初始化时直接采用
+        f->est[i] += ((z[i] - f->est[i]) * w) >> 8;
+        f->primed |= (uint32_t)(conf[i] != 0) << i;
+    }
+}
+
+static void filter_kalman(zone_filter_t *f, const int32_t *z, const uint8_t *conf)
+{
+    for (int i = 0; i < ZONE_FILTER_CHANNELS; i++)
+    {
+        uint32_t p = f->p[i] + ZONE_FILTER_KALMAN_Q;
+        p = p > ZONE_FILTER_KALMAN_P_MAX ? ZONE_FILTER_KALMAN_P_MAX : p;
+        // K = P / (P + R·255/conf), conf为0时K为0, 只做预测
+        uint32_t pc = p * conf[i];
+        uint32_t k = (pc << 8) / (pc + ZONE_FILTER_KALMAN_R * 255); // Q8
+        f->est[i] += ((z[i] - f->est[i]) * (int32_t)k) >> 8;
+        f->p[i] = p - ((k * p) >> 8);
+    }
+}
+
+// 通道号 = 目标序号 * RESULT_ZONES + 区号, 与结果页里的顺序相同
+void zone_filter_apply(zone_filter_t *f, tmf8821_object_t (*objects)[RESULT_ZONES])
+{
+    int32_t z[ZONE_FILTER_CHANNELS];
+    uint8_t conf[ZONE_FILTER_CHANNELS];
+
+    if (f->mode == ZONE_FILTER_NONE)
+        return;
+    for (int o = 0, i = 0; o < RESULT_OBJECTS; o++)
+        for (int k = 0; k < RESULT_ZONES; k++, i++)
+        {
+            conf[i] = objects[o][k].confidence;
+            z[i] = objects[o][k].distance_mm << 4;
+        }
+
+    if (f->mode == ZONE_FILTER_MEDIAN)
+        filter_median(f, z, conf);
+    else if (f->mode == ZONE_FILTER_EMA)
+        filter_ema(f, z, conf);
+    else
+        filter_kalman(f, z, conf);
+
+    for (int o = 0, i = 0; o < RESULT_OBJECTS; o++)
+        for (int k = 0; k < RESULT_ZONES; k++, i++)
+        {
+            int32_t mm = (f->est[i] + 8) >> 4;
+            mm &= ~(mm >> 31);
+            objects[o][k].distance_mm = mm;
+        }
+}
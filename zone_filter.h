@@ -0,0 +1,43 @@
+#ifndef ZONE_FILTER_H
+#define ZONE_FILTER_H
+
+#include <stdint.h>
+#include "tmf8821.h"
+
+// 逐区时域滤波: 每帧对结果页里的全部区记录(9区×2目标)做一次, 原地改写距离
+// 内部距离为1/16 mm定点数(Q4), 各状态按区排成数组(结构数组), 循环里尽量不分支
+#define ZONE_FILTER_CHANNELS (RESULT_ZONES * RESULT_OBJECTS)
+#define ZONE_FILTER_MEDIAN_LEN 5
+#define ZONE_FILTER_EMA_ALPHA 64   // Q8, 满置信度时的新值权重
+// 卡尔曼方差单位为1/16 mm²
+#define ZONE_FILTER_KALMAN_Q 4     // 过程噪声, 0.25 mm²/帧
+#define ZONE_FILTER_KALMAN_R 64    // 满置信度时的测量噪声, 4 mm²
+#define ZONE_FILTER_KALMAN_P_MAX 0x7FFF // 也是初值, 第一次测量几乎直接采用
+
+typedef enum
+{
+    ZONE_FILTER_NONE,
+    ZONE_FILTER_MEDIAN, // 5帧滑动中值, 无目标的帧沿用上次输出
+    ZONE_FILTER_EMA,    // 指数平均, 新值权重按置信度缩放
+    ZONE_FILTER_KALMAN, // 一维卡尔曼, 测量噪声与置信度成反比
+    ZONE_FILTER_MODES
+} zone_filter_mode_t;
+
+typedef struct
+{
+    zone_filter_mode_t mode;
+    uint8_t pos;                                                  // 中值窗口写入位置
+    uint32_t primed;                                              // 已有过有效测量的区
+    int32_t est[ZONE_FILTER_CHANNELS];                            // 输出(Q4)
+    uint16_t p[ZONE_FILTER_CHANNELS];                             // 卡尔曼估计方差
+    int32_t window[ZONE_FILTER_MEDIAN_LEN][ZONE_FILTER_CHANNELS]; // 中值窗口
+} zone_filter_t;
+
+extern const char *const zone_filter_names[ZONE_FILTER_MODES];
+
+void zone_filter_init(zone_filter_t *f, zone_filter_mode_t mode);
+
+// objects为一帧的全部目标(传入tmf8821_frame_t.objects), 就地改写距离
+void zone_filter_apply(zone_filter_t *f, tmf8821_object_t (*objects)[RESULT_ZONES]);
+
+#endif